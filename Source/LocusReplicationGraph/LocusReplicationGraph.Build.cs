@@ -8,9 +8,9 @@ namespace UnrealBuildTool.Rules
         {
             PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-            PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "ReplicationGraph" });
+            PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "ReplicationGraph", "Json" });
 
-            PrivateDependencyModuleNames.AddRange(new string[] { });
+            PrivateDependencyModuleNames.AddRange(new string[] { "AssetRegistry" });
 
             if (Target.bBuildDeveloperTools || (Target.Configuration != UnrealTargetConfiguration.Shipping && Target.Configuration != UnrealTargetConfiguration.Test))
             {
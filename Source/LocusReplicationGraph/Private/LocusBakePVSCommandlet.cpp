@@ -0,0 +1,211 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LocusBakePVSCommandlet.h"
+#include "LocusReplicationGraph.h"
+#include "LocusPVS.h"
+#include "Async/ParallelFor.h"
+#include "Engine/LevelBounds.h"
+#include "Engine/World.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+
+ULocusBakePVSCommandlet::ULocusBakePVSCommandlet()
+{
+	IsClient = false;
+	IsServer = true;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 ULocusBakePVSCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	FString MapPackageName;
+	FString GraphClassPath;
+	float CellSize = 1000.f;
+	float MaxDistance = 15000.f;
+	float EyeHeight = 170.f;
+	int32 Samples = 2;
+	int32 MaxFloors = 4;
+
+	if (!FParse::Value(*Params, TEXT("Map="), MapPackageName))
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Usage: -run=LocusBakePVS -Map=<MapPackageName> [-Graph=<GraphClassPath>] [-CellSize=<cm>] [-MaxDistance=<cm>] [-EyeHeight=<cm>] [-Samples=<per cell axis>] [-MaxFloors=<n>]"));
+		return 1;
+	}
+	FParse::Value(*Params, TEXT("Graph="), GraphClassPath);
+	FParse::Value(*Params, TEXT("CellSize="), CellSize);
+	FParse::Value(*Params, TEXT("MaxDistance="), MaxDistance);
+	FParse::Value(*Params, TEXT("EyeHeight="), EyeHeight);
+	FParse::Value(*Params, TEXT("Samples="), Samples);
+	FParse::Value(*Params, TEXT("MaxFloors="), MaxFloors);
+	CellSize = FMath::Max(CellSize, 100.f);
+	Samples = FMath::Clamp(Samples, 1, 4);
+	MaxFloors = FMath::Clamp(MaxFloors, 1, 16);
+
+	//bounds overrides and output directory come from the graph
+	UClass* GraphClass = GraphClassPath.IsEmpty() ? ULocusReplicationGraph::StaticClass() : LoadClass<ULocusReplicationGraph>(nullptr, *GraphClassPath);
+	if (!GraphClass)
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Could not load LocusReplicationGraph class %s"), *GraphClassPath);
+		return 1;
+	}
+	const ULocusReplicationGraph* Graph = GetDefault<ULocusReplicationGraph>(GraphClass);
+
+	UPackage* MapPackage = LoadPackage(nullptr, *MapPackageName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Could not load map %s"), *MapPackageName);
+		return 1;
+	}
+
+	World->WorldType = EWorldType::Editor;
+	World->AddToRoot();
+	if (!World->bIsWorldInitialized)
+	{
+		UWorld::InitializationValues IVS;
+		IVS.RequiresHitProxies(false).ShouldSimulatePhysics(false).EnableTraceCollision(true).CreateNavigation(false).CreateAISystem(false).AllowAudioPlayback(false).CreatePhysicsScene(true);
+		World->InitWorld(IVS);
+		World->PersistentLevel->UpdateModelComponents();
+		World->UpdateWorldComponents(true, false);
+	}
+	World->LoadSecondaryLevels();
+	World->FlushLevelStreaming(EFlushLevelStreamingType::Full);
+
+	const FBox2D Bounds = Graph->ComputeSpatialBounds(World);
+	if (!Bounds.bIsValid)
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Map %s has no level bounds or spatial bounds override"), *MapPackageName);
+		World->CleanupWorld();
+		World->RemoveFromRoot();
+		return 1;
+	}
+
+	//height range to search floors in
+	FBox LevelBounds(ForceInit);
+	for (ULevel* Level : World->GetLevels())
+	{
+		if (Level)
+		{
+			LevelBounds += ALevelBounds::CalculateLevelBounds(Level);
+		}
+	}
+	const float MaxZ = LevelBounds.IsValid ? LevelBounds.Max.Z + 100.f : HALF_WORLD_MAX;
+	const float MinZ = LevelBounds.IsValid ? LevelBounds.Min.Z - 100.f : -HALF_WORLD_MAX;
+
+	FLocusCellGrid Grid;
+	Grid.Init(Bounds, CellSize);
+	const int32 RadiusCells = FMath::CeilToInt(MaxDistance / CellSize);
+	const int32 WordsPerRow = FLocusPVSTable::GetWordsPerRow(RadiusCells);
+	const double StartTime = FPlatformTime::Seconds();
+
+	UE_LOG(LogLocusReplicationGraph, Display, TEXT("Baking PVS of %s: %dx%d cells of %.0f, radius %d cells"), *MapPackageName, Grid.NumX, Grid.NumY, CellSize, RadiusCells);
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(LocusBakePVS), false);
+
+	//eye points of each cell: every floor under Samples x Samples points, found by tracing down through the level
+	TArray<TArray<FVector>> CellPoints;
+	CellPoints.SetNum(Grid.Num());
+	ParallelFor(Grid.Num(), [&](int32 CellIndex)
+	{
+		const FIntPoint Coord = Grid.GetCoord(CellIndex);
+		TArray<FVector>& Points = CellPoints[CellIndex];
+		for (int32 SampleY = 0; SampleY < Samples; ++SampleY)
+		{
+			for (int32 SampleX = 0; SampleX < Samples; ++SampleX)
+			{
+				const FVector2D Sample = Grid.Origin + FVector2D((Coord.X + (SampleX + 0.5f) / Samples) * CellSize, (Coord.Y + (SampleY + 0.5f) / Samples) * CellSize);
+				FVector Start(Sample, MaxZ);
+				const FVector End(Sample, MinZ);
+				for (int32 Floor = 0; Floor < MaxFloors; ++Floor)
+				{
+					FHitResult Hit;
+					if (!World->LineTraceSingleByChannel(Hit, Start, End, ECC_Visibility, QueryParams))
+					{
+						break;
+					}
+					if (!Hit.bStartPenetrating)
+					{
+						Points.Add(Hit.ImpactPoint + FVector(0.f, 0.f, EyeHeight));
+					}
+					//continue below the floor that was hit
+					Start = FVector(Sample, Hit.ImpactPoint.Z - 50.f);
+				}
+			}
+		}
+
+		//no collision under cell at all, see it from ground level of bounds
+		if (Points.Num() == 0)
+		{
+			Points.Add(FVector(Grid.GetCellCenter(Coord), MinZ + EyeHeight));
+		}
+	});
+
+	//each pair is traced once from the lower index, the upper index is mirrored afterwards
+	TArray<uint32> Rows;
+	Rows.SetNumZeroed(Grid.Num() * WordsPerRow);
+	ParallelFor(Grid.Num(), [&](int32 CellIndex)
+	{
+		const FIntPoint Coord = Grid.GetCoord(CellIndex);
+		uint32* Row = Rows.GetData() + (int64)CellIndex * WordsPerRow;
+		const int32 SelfBit = FLocusPVSTable::GetWindowBit(Coord, Coord, RadiusCells);
+		Row[SelfBit / 32] |= 1u << (SelfBit % 32);
+
+		Grid.ForEachCellInRadius(CellIndex, MaxDistance, [&](int32 OtherIndex)
+		{
+			if (OtherIndex <= CellIndex)
+			{
+				return;
+			}
+
+			bool bVisible = false;
+			for (int32 From = 0; From < CellPoints[CellIndex].Num() && !bVisible; ++From)
+			{
+				for (int32 To = 0; To < CellPoints[OtherIndex].Num() && !bVisible; ++To)
+				{
+					bVisible = !World->LineTraceTestByChannel(CellPoints[CellIndex][From], CellPoints[OtherIndex][To], ECC_Visibility, QueryParams);
+				}
+			}
+
+			if (bVisible)
+			{
+				const int32 Bit = FLocusPVSTable::GetWindowBit(Coord, Grid.GetCoord(OtherIndex), RadiusCells);
+				Row[Bit / 32] |= 1u << (Bit % 32);
+			}
+		});
+	});
+
+	int64 NumVisiblePairs = 0;
+	for (int32 CellIndex = 0; CellIndex < Grid.Num(); ++CellIndex)
+	{
+		const FIntPoint Coord = Grid.GetCoord(CellIndex);
+		Grid.ForEachCellInRadius(CellIndex, MaxDistance, [&](int32 OtherIndex)
+		{
+			const int32 Bit = FLocusPVSTable::GetWindowBit(Coord, Grid.GetCoord(OtherIndex), RadiusCells);
+			if (OtherIndex > CellIndex && (Rows[(int64)CellIndex * WordsPerRow + Bit / 32] & (1u << (Bit % 32))))
+			{
+				const int32 MirrorBit = FLocusPVSTable::GetWindowBit(Grid.GetCoord(OtherIndex), Coord, RadiusCells);
+				Rows[(int64)OtherIndex * WordsPerRow + MirrorBit / 32] |= 1u << (MirrorBit % 32);
+				++NumVisiblePairs;
+			}
+		});
+	}
+
+	World->CleanupWorld();
+	World->RemoveFromRoot();
+
+	const FString Filename = Graph->GetPVSFilename(FPackageName::GetShortName(MapPackageName));
+	if (!FLocusPVSTable::Save(Filename, Grid, RadiusCells, Rows))
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Failed to save PVS table to %s"), *Filename);
+		return 1;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Display, TEXT("Baked PVS to %s: %lld visible cell pairs, %.1f KB, %.1f seconds"), *Filename, NumVisiblePairs, Rows.Num() * sizeof(uint32) / 1024.f, FPlatformTime::Seconds() - StartTime);
+	return 0;
+#else
+	UE_LOG(LogLocusReplicationGraph, Error, TEXT("LocusBakePVS commandlet requires an editor build"));
+	return 1;
+#endif
+}
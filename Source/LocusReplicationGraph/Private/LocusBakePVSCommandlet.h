@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "LocusBakePVSCommandlet.generated.h"
+
+/**
+ * Bakes a cell to cell potentially visible set of a map from it's collision into PVSDirectory of a LocusReplicationGraph.
+ * Usage: -run=LocusBakePVS -Map=/Game/Maps/City [-Graph=/Game/Path/BP_RepGraph.BP_RepGraph_C] [-CellSize=1000] [-MaxDistance=15000] [-EyeHeight=170] [-Samples=2] [-MaxFloors=4]
+ */
+UCLASS()
+class ULocusBakePVSCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	ULocusBakePVSCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LocusBakeRoutingTableCommandlet.h"
+#include "LocusReplicationGraph.h"
+#include "LocusReplicationRoutingTable.h"
+#include "AssetRegistryModule.h"
+#include "Engine/Blueprint.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+
+ULocusBakeRoutingTableCommandlet::ULocusBakeRoutingTableCommandlet()
+{
+	IsClient = false;
+	IsServer = true;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 ULocusBakeRoutingTableCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	FString GraphClassPath;
+	FString OutputPackageName;
+	float ServerMaxTickRate = 30.f;
+
+	if (!FParse::Value(*Params, TEXT("Graph="), GraphClassPath) || !FParse::Value(*Params, TEXT("Output="), OutputPackageName))
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Usage: -run=LocusBakeRoutingTable -Graph=<GraphClassPath> -Output=<PackageName> [-TickRate=<NetServerMaxTickRate>]"));
+		return 1;
+	}
+	FParse::Value(*Params, TEXT("TickRate="), ServerMaxTickRate);
+
+	UClass* GraphClass = LoadClass<ULocusReplicationGraph>(nullptr, *GraphClassPath);
+	if (!GraphClass)
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Could not load LocusReplicationGraph class %s"), *GraphClassPath);
+		return 1;
+	}
+
+	//blueprint actor classes are only resolved when they are loaded, load all of them
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+	AssetRegistry.SearchAllAssets(true);
+
+	TArray<FAssetData> BlueprintAssets;
+	AssetRegistry.GetAssetsByClass(UBlueprint::StaticClass()->GetFName(), BlueprintAssets, true);
+	for (const FAssetData& BlueprintAsset : BlueprintAssets)
+	{
+		BlueprintAsset.GetAsset();
+	}
+
+	UPackage* Package = CreatePackage(*OutputPackageName);
+	Package->FullyLoad();
+
+	const FString AssetName = FPackageName::GetShortName(OutputPackageName);
+	ULocusReplicationRoutingTable* Table = FindObject<ULocusReplicationRoutingTable>(Package, *AssetName);
+	if (!Table)
+	{
+		Table = NewObject<ULocusReplicationRoutingTable>(Package, *AssetName, RF_Public | RF_Standalone);
+		FAssetRegistryModule::AssetCreated(Table);
+	}
+
+	ULocusReplicationGraph* Graph = NewObject<ULocusReplicationGraph>(GetTransientPackage(), GraphClass);
+	Graph->BakeRoutingTable(Table, ServerMaxTickRate);
+	Package->MarkPackageDirty();
+
+	const FString Filename = FPackageName::LongPackageNameToFilename(OutputPackageName, FPackageName::GetAssetPackageExtension());
+	if (!UPackage::SavePackage(Package, Table, RF_Public | RF_Standalone, *Filename))
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Failed to save routing table to %s"), *Filename);
+		return 1;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Display, TEXT("Baked %d classes to %s (tick rate %.1f)"), Table->Classes.Num(), *Filename, ServerMaxTickRate);
+	return 0;
+#else
+	UE_LOG(LogLocusReplicationGraph, Error, TEXT("LocusBakeRoutingTable commandlet requires an editor build"));
+	return 1;
+#endif
+}
@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "LocusBakeRoutingTableCommandlet.generated.h"
+
+/**
+ * Bakes class routing policies and replication infos of a LocusReplicationGraph into a ULocusReplicationRoutingTable asset.
+ * Usage: -run=LocusBakeRoutingTable -Graph=/Game/Path/BP_RepGraph.BP_RepGraph_C -Output=/Game/Path/RoutingTable [-TickRate=30]
+ */
+UCLASS()
+class ULocusBakeRoutingTableCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	ULocusBakeRoutingTableCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
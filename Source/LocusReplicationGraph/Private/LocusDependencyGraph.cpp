@@ -0,0 +1,256 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LocusDependencyGraph.h"
+#include "LocusReplicationGraph.h"
+
+void FLocusDependencyGraph::QueueAdd(AActor* Replicator, AActor* Dependent)
+{
+	PendingOps.Add({ Replicator, Dependent, EOpType::Add });
+}
+
+void FLocusDependencyGraph::QueueRemove(AActor* Replicator, AActor* Dependent)
+{
+	PendingOps.Add({ Replicator, Dependent, EOpType::Remove });
+}
+
+void FLocusDependencyGraph::QueueRemoveAll(AActor* Replicator)
+{
+	PendingOps.Add({ Replicator, nullptr, EOpType::RemoveAll });
+}
+
+bool FLocusDependencyGraph::IsReachable(AActor* From, AActor* To) const
+{
+	if (From == To)
+	{
+		return true;
+	}
+
+	TSet<AActor*> Descendants;
+	CollectDescendants(From, Descendants);
+	return Descendants.Contains(To);
+}
+
+void FLocusDependencyGraph::CollectAncestors(AActor* Actor, TSet<AActor*>& OutAncestors) const
+{
+	TArray<AActor*, TInlineAllocator<16>> Stack;
+	Stack.Add(Actor);
+	while (Stack.Num() > 0)
+	{
+		if (const TSet<AActor*>* ActorParents = Parents.Find(Stack.Pop(false)))
+		{
+			for (AActor* Parent : *ActorParents)
+			{
+				bool bAlreadyVisited = false;
+				OutAncestors.Add(Parent, &bAlreadyVisited);
+				if (!bAlreadyVisited)
+				{
+					Stack.Add(Parent);
+				}
+			}
+		}
+	}
+}
+
+void FLocusDependencyGraph::CollectDescendants(AActor* Actor, TSet<AActor*>& OutDescendants) const
+{
+	TArray<AActor*, TInlineAllocator<16>> Stack;
+	Stack.Add(Actor);
+	while (Stack.Num() > 0)
+	{
+		if (const TSet<AActor*>* ActorChildren = Children.Find(Stack.Pop(false)))
+		{
+			for (AActor* Child : *ActorChildren)
+			{
+				bool bAlreadyVisited = false;
+				OutDescendants.Add(Child, &bAlreadyVisited);
+				if (!bAlreadyVisited)
+				{
+					Stack.Add(Child);
+				}
+			}
+		}
+	}
+}
+
+void FLocusDependencyGraph::RemoveEdge(AActor* Replicator, AActor* Dependent)
+{
+	if (TSet<AActor*>* ReplicatorChildren = Children.Find(Replicator))
+	{
+		ReplicatorChildren->Remove(Dependent);
+		if (ReplicatorChildren->Num() == 0)
+		{
+			Children.Remove(Replicator);
+		}
+	}
+
+	if (TSet<AActor*>* DependentParents = Parents.Find(Dependent))
+	{
+		DependentParents->Remove(Replicator);
+		if (DependentParents->Num() == 0)
+		{
+			Parents.Remove(Dependent);
+		}
+	}
+}
+
+void FLocusDependencyGraph::Flatten(AActor* Replicator, FApplyDependencyFunc Apply)
+{
+	TSet<AActor*> Descendants;
+	CollectDescendants(Replicator, Descendants);
+
+	TSet<AActor*>& Applied = Flattened.FindOrAdd(Replicator);
+	for (AActor* Descendant : Descendants)
+	{
+		if (!Applied.Contains(Descendant))
+		{
+			Apply(Replicator, Descendant, true);
+		}
+	}
+	for (AActor* AppliedDependent : Applied)
+	{
+		if (!Descendants.Contains(AppliedDependent))
+		{
+			Apply(Replicator, AppliedDependent, false);
+		}
+	}
+
+	if (Descendants.Num() > 0)
+	{
+		Applied = MoveTemp(Descendants);
+	}
+	else
+	{
+		Flattened.Remove(Replicator);
+	}
+}
+
+void FLocusDependencyGraph::ApplyPendingChanges(FIsNetworkedFunc IsNetworked, FApplyDependencyFunc Apply)
+{
+	//replicators whose flattened list has to be recomputed
+	TSet<AActor*> DirtyReplicators;
+
+	for (const FPendingOp& Op : PendingOps)
+	{
+		AActor* Replicator = Op.Replicator.Get();
+		AActor* Dependent = Op.Dependent.Get();
+		if (!Replicator || (Op.Type != EOpType::RemoveAll && !Dependent))
+		{
+			continue;
+		}
+
+		switch (Op.Type)
+		{
+		case EOpType::Add:
+		{
+			if (!IsNetworked(Replicator))
+			{
+				UE_LOG(LogLocusReplicationGraph, Warning, TEXT("ReplicatorActor privided is not replicating"));
+				continue;
+			}
+			//graph is never told when an actor that is not networked goes away, it's edges would dangle
+			if (!IsNetworked(Dependent))
+			{
+				UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Dependency %s -> %s ignored, dependent is not replicating"), *Replicator->GetName(), *Dependent->GetName());
+				continue;
+			}
+			if (IsReachable(Dependent, Replicator))
+			{
+				UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Dependency %s -> %s ignored, it would make a cycle"), *Replicator->GetName(), *Dependent->GetName());
+				continue;
+			}
+
+			bool bAlreadyDependent = false;
+			Children.FindOrAdd(Replicator).Add(Dependent, &bAlreadyDependent);
+			if (bAlreadyDependent)
+			{
+				continue;
+			}
+			Parents.FindOrAdd(Dependent).Add(Replicator);
+			break;
+		}
+
+		case EOpType::Remove:
+		{
+			RemoveEdge(Replicator, Dependent);
+			break;
+		}
+
+		case EOpType::RemoveAll:
+		{
+			if (const TSet<AActor*>* ReplicatorChildren = Children.Find(Replicator))
+			{
+				for (AActor* Child : ReplicatorChildren->Array())
+				{
+					RemoveEdge(Replicator, Child);
+				}
+			}
+			break;
+		}
+		}
+
+		DirtyReplicators.Add(Replicator);
+		CollectAncestors(Replicator, DirtyReplicators);
+	}
+	PendingOps.Reset();
+
+	for (AActor* Replicator : DirtyReplicators)
+	{
+		Flatten(Replicator, Apply);
+	}
+}
+
+void FLocusDependencyGraph::RemoveActor(AActor* Actor, FApplyDependencyFunc Apply)
+{
+	//it's own list goes away with it's replication info
+	Flattened.Remove(Actor);
+
+	if (!Children.Contains(Actor) && !Parents.Contains(Actor))
+	{
+		return;
+	}
+
+	TSet<AActor*> Ancestors;
+	CollectAncestors(Actor, Ancestors);
+
+	if (const TSet<AActor*>* ActorChildren = Children.Find(Actor))
+	{
+		for (AActor* Child : ActorChildren->Array())
+		{
+			RemoveEdge(Actor, Child);
+		}
+	}
+	if (const TSet<AActor*>* ActorParents = Parents.Find(Actor))
+	{
+		for (AActor* Parent : ActorParents->Array())
+		{
+			RemoveEdge(Parent, Actor);
+		}
+	}
+
+	for (AActor* Ancestor : Ancestors)
+	{
+		Flatten(Ancestor, Apply);
+	}
+}
+
+void FLocusDependencyGraph::GetDependents(AActor* Replicator, TArray<AActor*>& OutDependents, bool bTransitive) const
+{
+	if (bTransitive)
+	{
+		TSet<AActor*> Descendants;
+		CollectDescendants(Replicator, Descendants);
+		OutDependents.Append(Descendants.Array());
+	}
+	else if (const TSet<AActor*>* ReplicatorChildren = Children.Find(Replicator))
+	{
+		OutDependents.Append(ReplicatorChildren->Array());
+	}
+}
+
+void FLocusDependencyGraph::Reset()
+{
+	Children.Reset();
+	Parents.Reset();
+	Flattened.Reset();
+	PendingOps.Reset();
+}
@@ -0,0 +1,298 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LocusPVS.h"
+#include "LocusReplicationGraph.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+int32 FLocusPVSTable::GetWindowBit(const FIntPoint& Center, const FIntPoint& Other, int32 RadiusCells)
+{
+	const int32 DX = Other.X - Center.X + RadiusCells;
+	const int32 DY = Other.Y - Center.Y + RadiusCells;
+	const int32 WindowSize = RadiusCells * 2 + 1;
+	if (DX < 0 || DX >= WindowSize || DY < 0 || DY >= WindowSize)
+	{
+		return INDEX_NONE;
+	}
+	return DY * WindowSize + DX;
+}
+
+bool FLocusPVSTable::Save(const FString& Filename, const FLocusCellGrid& Grid, int32 RadiusCells, const TArray<uint32>& Rows)
+{
+	FHeader Header;
+	Header.Magic = FileMagic;
+	Header.Version = FileVersion;
+	Header.OriginX = Grid.Origin.X;
+	Header.OriginY = Grid.Origin.Y;
+	Header.CellSize = Grid.CellSize;
+	Header.NumX = Grid.NumX;
+	Header.NumY = Grid.NumY;
+	Header.RadiusCells = RadiusCells;
+	Header.WordsPerRow = GetWordsPerRow(RadiusCells);
+
+	if (Rows.Num() != Grid.Num() * Header.WordsPerRow)
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("PVS rows don't match grid: %d words for %d cells"), Rows.Num(), Grid.Num());
+		return false;
+	}
+
+	TArray<uint8> Data;
+	Data.Append(reinterpret_cast<const uint8*>(&Header), sizeof(FHeader));
+	Data.Append(reinterpret_cast<const uint8*>(Rows.GetData()), Rows.Num() * sizeof(uint32));
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+	return FFileHelper::SaveArrayToFile(Data, *Filename);
+}
+
+bool FLocusPVSTable::Load(const FString& Filename)
+{
+	Reset();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Filename))
+	{
+		return false;
+	}
+
+	MappedHandle.Reset(PlatformFile.OpenMapped(*Filename));
+	if (MappedHandle)
+	{
+		MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+	}
+
+	if (MappedRegion)
+	{
+		if (InitFromData(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize(), Filename))
+		{
+			return true;
+		}
+	}
+	else
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Could not map PVS table %s, reading it into memory"), *Filename);
+		if (FFileHelper::LoadFileToArray(LoadedData, *Filename) && InitFromData(LoadedData.GetData(), LoadedData.Num(), Filename))
+		{
+			return true;
+		}
+	}
+
+	Reset();
+	return false;
+}
+
+bool FLocusPVSTable::InitFromData(const uint8* Data, int64 Size, const FString& Filename)
+{
+	if (Size < (int64)sizeof(FHeader))
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("PVS table %s is truncated"), *Filename);
+		return false;
+	}
+
+	FHeader Header;
+	FMemory::Memcpy(&Header, Data, sizeof(FHeader));
+	if (Header.Magic != FileMagic || Header.Version != FileVersion)
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("PVS table %s has unknown format(version %u), bake it again"), *Filename, Header.Version);
+		return false;
+	}
+
+	const int64 ExpectedSize = sizeof(FHeader) + (int64)Header.NumX * Header.NumY * Header.WordsPerRow * sizeof(uint32);
+	if (Header.NumX <= 0 || Header.NumY <= 0 || Header.CellSize <= 0.f || Header.RadiusCells < 0 || Header.WordsPerRow != GetWordsPerRow(Header.RadiusCells) || Size != ExpectedSize)
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("PVS table %s is corrupted"), *Filename);
+		return false;
+	}
+
+	Grid.Origin = FVector2D(Header.OriginX, Header.OriginY);
+	Grid.CellSize = Header.CellSize;
+	Grid.NumX = Header.NumX;
+	Grid.NumY = Header.NumY;
+	RadiusCells = Header.RadiusCells;
+	WordsPerRow = Header.WordsPerRow;
+	Rows = reinterpret_cast<const uint32*>(Data + sizeof(FHeader));
+	return true;
+}
+
+void FLocusPVSTable::Reset()
+{
+	Rows = nullptr;
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+	LoadedData.Empty();
+	Grid = FLocusCellGrid();
+	RadiusCells = 0;
+	WordsPerRow = 0;
+}
+
+bool FLocusPVSTable::IsVisible(int32 FromCell, int32 ToCell) const
+{
+	if (!IsValid())
+	{
+		return true;
+	}
+
+	const int32 Bit = GetWindowBit(Grid.GetCoord(FromCell), Grid.GetCoord(ToCell), RadiusCells);
+	if (Bit == INDEX_NONE)
+	{
+		return false;
+	}
+	return (Rows[(int64)FromCell * WordsPerRow + Bit / 32] & (1u << (Bit % 32))) != 0;
+}
+
+UReplicationGraphNode_PVS::UReplicationGraphNode_PVS()
+{
+	bRequiresPrepareForReplicationCall = true;
+}
+
+bool UReplicationGraphNode_PVS::LoadTable(const FString& Filename)
+{
+	for (UReplicationGraphNode_ActorList*& Cell : Cells)
+	{
+		if (Cell)
+		{
+			Cell->NotifyResetAllNetworkActors();
+			FreeCells.Add(Cell);
+			Cell = nullptr;
+		}
+	}
+
+	const bool bLoaded = Table.Load(Filename);
+	const FLocusCellGrid& Grid = Table.GetGrid();
+	Cells.SetNumZeroed(Grid.Num());
+	CellGatherStamps.Init(0, Grid.Num());
+	GatherStamp = 0;
+
+	for (auto& PVSActorPair : PVSActors)
+	{
+		FPVSActor& PVSActor = PVSActorPair.Value;
+		PVSActor.CellIndex = bLoaded ? Grid.GetIndex(PVSActor.ActorInfo.Actor->GetActorLocation()) : INDEX_NONE;
+		if (PVSActor.CellIndex != INDEX_NONE)
+		{
+			GetOrCreateCell(PVSActor.CellIndex)->NotifyAddNetworkActor(PVSActor.ActorInfo);
+		}
+	}
+
+	if (bLoaded)
+	{
+		UE_LOG(LogLocusReplicationGraph, Log, TEXT("Loaded PVS table %s: %dx%d cells of %.0f, radius %d cells"), *Filename, Grid.NumX, Grid.NumY, Grid.CellSize, Table.GetRadiusCells());
+	}
+	return bLoaded;
+}
+
+UReplicationGraphNode_ActorList* UReplicationGraphNode_PVS::GetOrCreateCell(int32 CellIndex)
+{
+	UReplicationGraphNode_ActorList*& Cell = Cells[CellIndex];
+	if (!Cell)
+	{
+		Cell = FreeCells.Num() > 0 ? FreeCells.Pop(false) : CreateChildNode<UReplicationGraphNode_ActorList>();
+	}
+	return Cell;
+}
+
+void UReplicationGraphNode_PVS::NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo)
+{
+	FPVSActor& PVSActor = PVSActors.Add(ActorInfo.Actor);
+	PVSActor.ActorInfo = ActorInfo;
+	PVSActor.GlobalInfo = &GraphGlobals->GlobalActorReplicationInfoMap->Get(ActorInfo.Actor);
+
+	if (Table.IsValid())
+	{
+		PVSActor.GlobalInfo->WorldLocation = ActorInfo.Actor->GetActorLocation();
+		PVSActor.CellIndex = Table.GetGrid().GetIndex(PVSActor.GlobalInfo->WorldLocation);
+		GetOrCreateCell(PVSActor.CellIndex)->NotifyAddNetworkActor(ActorInfo);
+	}
+}
+
+bool UReplicationGraphNode_PVS::NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound)
+{
+	FPVSActor PVSActor;
+	if (!PVSActors.RemoveAndCopyValue(ActorInfo.Actor, PVSActor))
+	{
+		UE_CLOG(bWarnIfNotFound, LogLocusReplicationGraph, Warning, TEXT("Attempted to remove %s from PVS node %s but it was not found."), *GetActorRepListTypeDebugString(ActorInfo.Actor), *GetName());
+		return false;
+	}
+
+	if (PVSActor.CellIndex != INDEX_NONE)
+	{
+		Cells[PVSActor.CellIndex]->NotifyRemoveNetworkActor(ActorInfo);
+	}
+	return true;
+}
+
+void UReplicationGraphNode_PVS::NotifyResetAllNetworkActors()
+{
+	PVSActors.Reset();
+	Super::NotifyResetAllNetworkActors();
+}
+
+void UReplicationGraphNode_PVS::PrepareForReplication()
+{
+	if (!Table.IsValid())
+	{
+		return;
+	}
+
+	const FLocusCellGrid& Grid = Table.GetGrid();
+	for (auto& PVSActorPair : PVSActors)
+	{
+		FPVSActor& PVSActor = PVSActorPair.Value;
+		PVSActor.GlobalInfo->WorldLocation = PVSActor.ActorInfo.Actor->GetActorLocation();
+
+		const int32 CellIndex = Grid.GetIndex(PVSActor.GlobalInfo->WorldLocation);
+		if (CellIndex != PVSActor.CellIndex)
+		{
+			if (PVSActor.CellIndex != INDEX_NONE)
+			{
+				Cells[PVSActor.CellIndex]->NotifyRemoveNetworkActor(PVSActor.ActorInfo);
+			}
+			PVSActor.CellIndex = CellIndex;
+			GetOrCreateCell(CellIndex)->NotifyAddNetworkActor(PVSActor.ActorInfo);
+		}
+	}
+}
+
+void UReplicationGraphNode_PVS::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	LOCUS_SCOPE_GATHER_STAT(PVS, Params);
+	const FLocusScopedFollowGather FollowGather(Params, true);
+	if (FollowGather.ShouldSkip())
+	{
+		return;
+	}
+
+	if (!Table.IsValid())
+	{
+		return;
+	}
+
+	if (++GatherStamp == 0)
+	{
+		FMemory::Memzero(CellGatherStamps.GetData(), CellGatherStamps.Num() * sizeof(uint32));
+		GatherStamp = 1;
+	}
+
+	const FLocusCellGrid& Grid = Table.GetGrid();
+	for (const FNetViewer& Viewer : Params.Viewers)
+	{
+		Table.ForEachVisibleCell(Grid.GetIndex(Viewer.ViewLocation), [&](int32 CellIndex)
+		{
+			if (CellGatherStamps[CellIndex] != GatherStamp)
+			{
+				CellGatherStamps[CellIndex] = GatherStamp;
+				if (UReplicationGraphNode_ActorList* Cell = Cells[CellIndex])
+				{
+					Cell->GatherActorListsForConnection(Params);
+				}
+			}
+		});
+	}
+}
+
+void UReplicationGraphNode_PVS::GetAllActorsInNode_Debugging(TArray<FActorRepListType>& OutArray) const
+{
+	for (const auto& PVSActorPair : PVSActors)
+	{
+		OutArray.Add(PVSActorPair.Key);
+	}
+}
@@ -36,6 +36,72 @@ void ULocusReplicationBPHelpers::RemoveDependentActor(AActor* ReplicatorActor, A
 	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
 }
 
+void ULocusReplicationBPHelpers::AddDependentActors(AActor* ReplicatorActor, const TArray<AActor*>& DependentActors)
+{
+	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(ReplicatorActor))
+	{
+		LocusGraph->AddDependentActors(ReplicatorActor, DependentActors);
+		return;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
+}
+
+void ULocusReplicationBPHelpers::RemoveDependentActors(AActor* ReplicatorActor, const TArray<AActor*>& DependentActors)
+{
+	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(ReplicatorActor))
+	{
+		LocusGraph->RemoveDependentActors(ReplicatorActor, DependentActors);
+		return;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
+}
+
+void ULocusReplicationBPHelpers::RemoveAllDependentActors(AActor* ReplicatorActor)
+{
+	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(ReplicatorActor))
+	{
+		LocusGraph->RemoveAllDependentActors(ReplicatorActor);
+		return;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
+}
+
+void ULocusReplicationBPHelpers::AddVisionSource(AActor* Source, FName TeamName, float Radius)
+{
+	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(Source))
+	{
+		LocusGraph->AddVisionSource(Source, TeamName, Radius);
+		return;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
+}
+
+void ULocusReplicationBPHelpers::RemoveVisionSource(AActor* Source)
+{
+	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(Source))
+	{
+		LocusGraph->RemoveVisionSource(Source);
+		return;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
+}
+
+void ULocusReplicationBPHelpers::SetViewFollowTarget(APlayerController* Follower, APlayerController* Target)
+{
+	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(Follower))
+	{
+		LocusGraph->SetViewFollowTarget(Follower, Target);
+		return;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
+}
+
 void ULocusReplicationBPHelpers::ChangeOwnerAndRefreshReplication(AActor* ActorToChange, AActor* NewOwner)
 {
 	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(ActorToChange))
@@ -47,6 +113,50 @@ void ULocusReplicationBPHelpers::ChangeOwnerAndRefreshReplication(AActor* ActorT
 	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
 }
 
+void ULocusReplicationBPHelpers::SetActorCullDistanceOverride(AActor* Actor, float CullDistance)
+{
+	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(Actor))
+	{
+		LocusGraph->SetActorCullDistanceOverride(Actor, CullDistance);
+		return;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
+}
+
+void ULocusReplicationBPHelpers::SetActorReplicationPeriodOverride(AActor* Actor, int32 ReplicationPeriodFrame)
+{
+	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(Actor))
+	{
+		LocusGraph->SetActorReplicationPeriodOverride(Actor, ReplicationPeriodFrame);
+		return;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
+}
+
+void ULocusReplicationBPHelpers::SetActorPriorityScaleOverride(AActor* Actor, float DistancePriorityScale, float StarvationPriorityScale)
+{
+	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(Actor))
+	{
+		LocusGraph->SetActorPriorityScaleOverride(Actor, DistancePriorityScale, StarvationPriorityScale);
+		return;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
+}
+
+void ULocusReplicationBPHelpers::ClearActorReplicationOverrides(AActor* Actor)
+{
+	if (ULocusReplicationGraph* LocusGraph = FindLocusReplicationGraph(Actor))
+	{
+		LocusGraph->ClearActorReplicationOverrides(Actor);
+		return;
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Warning, TEXT("LocusReplicationGraph not found"));
+}
+
 ULocusReplicationGraph* ULocusReplicationBPHelpers::FindLocusReplicationGraph(const UObject* WorldContextObject)
 {
 	if (WorldContextObject)
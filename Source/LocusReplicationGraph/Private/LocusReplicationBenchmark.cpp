@@ -0,0 +1,389 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LocusReplicationBenchmark.h"
+#include "LocusReplicationGraph.h"
+#include "Components/SceneComponent.h"
+#include "Engine/NetConnection.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/EngineVersion.h"
+
+ALocusBenchmarkActor::ALocusBenchmarkActor()
+{
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	bReplicates = true;
+	SetReplicatingMovement(true);
+	PrimaryActorTick.bCanEverTick = false;
+}
+
+ULocusBenchmarkNetDriver::ULocusBenchmarkNetDriver()
+{
+	NetConnectionClassName = TEXT("/Script/Engine.SimulatedClientNetConnection");
+}
+
+bool ULocusBenchmarkNetDriver::InitConnect(FNetworkNotify* InNotify, const FURL& ConnectURL, FString& Error)
+{
+	Error = TEXT("LocusBenchmarkNetDriver can only listen");
+	return false;
+}
+
+bool ULocusBenchmarkNetDriver::InitListen(FNetworkNotify* InNotify, FURL& LocalURL, bool bReuseAddressAndPort, FString& Error)
+{
+	return InitBase(false, InNotify, LocalURL, bReuseAddressAndPort, Error);
+}
+
+FLocusReplicationBenchmark::FLocusReplicationBenchmark()
+{
+}
+
+FLocusReplicationBenchmark::~FLocusReplicationBenchmark()
+{
+	Shutdown();
+}
+
+bool FLocusReplicationBenchmark::Init(const FLocusBenchmarkSettings& InSettings)
+{
+	Settings = InSettings;
+	Random.Initialize(Settings.RandomSeed);
+	UsedMemoryAtStart = FPlatformMemory::GetStats().UsedPhysical;
+
+	ReplicateMs = FLocusStatBuffer(Settings.NumFrames);
+	RouteMs = FLocusStatBuffer(Settings.NumFrames);
+	PendingMs = FLocusStatBuffer(Settings.NumFrames);
+	for (FLocusStatBuffer& Buffer : GatherMs)
+	{
+		Buffer = FLocusStatBuffer(Settings.NumFrames);
+	}
+
+	World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("LocusBenchmark"), nullptr, true, ERHIFeatureLevel::Num,
+		&UWorld::InitializationValues().AllowAudioPlayback(false).RequiresHitProxies(false).CreatePhysicsScene(false).CreateNavigation(false).CreateAISystem(false).ShouldSimulatePhysics(false));
+	if (!World)
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Benchmark could not create world"));
+		return false;
+	}
+
+	FString Error;
+	NetDriver = NewObject<ULocusBenchmarkNetDriver>(GetTransientPackage());
+	if (!NetDriver->InitListen(nullptr, World->URL, false, Error))
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Benchmark could not init net driver: %s"), *Error);
+		return false;
+	}
+	NetDriver->SetWorld(World);
+	World->SetNetDriver(NetDriver);
+
+	UClass* GraphClass = Settings.GraphClass ? Settings.GraphClass : ULocusReplicationGraph::StaticClass();
+	Graph = NewObject<ULocusReplicationGraph>(GetTransientPackage(), GraphClass);
+
+	//policies of benchmark actors, fixed bounds since the world has no level geometry
+	auto AddPolicy = [this](UClass* Class, EClassRepNodeMapping Policy)
+	{
+		FClassReplicationPolicyPreset& Preset = Graph->ReplicationPolicySettings.AddDefaulted_GetRef();
+		Preset.Class = Class;
+		Preset.Policy = Policy;
+	};
+	AddPolicy(ALocusBenchmarkSpatializedActor::StaticClass(), EClassRepNodeMapping::Spatialize_Dynamic);
+	AddPolicy(ALocusBenchmarkOwnerActor::StaticClass(), EClassRepNodeMapping::RelevantOwnerConnection);
+	AddPolicy(ALocusBenchmarkTeamActor::StaticClass(), EClassRepNodeMapping::RelevantTeamConnection);
+	AddPolicy(ALocusBenchmarkDependentActor::StaticClass(), EClassRepNodeMapping::NotRouted);
+	const FBox SpatialBounds = Settings.SpatialBounds.bIsValid ? FBox(FVector(Settings.SpatialBounds.Min, 0.f), FVector(Settings.SpatialBounds.Max, 0.f)) : FBox(FVector(-Settings.WorldExtent), FVector(Settings.WorldExtent));
+	Graph->SpatialBoundsOverrides.Add(FName(*UWorld::RemovePIEPrefix(World->GetMapName())), SpatialBounds);
+
+	NetDriver->SetReplicationDriver(Graph);
+	return true;
+}
+
+void FLocusReplicationBenchmark::Shutdown()
+{
+	if (NetDriver)
+	{
+		NetDriver->Shutdown();
+		NetDriver->SetReplicationDriver(nullptr);
+	}
+	if (World)
+	{
+		World->SetNetDriver(nullptr);
+		World->DestroyWorld(false);
+		World->RemoveFromRoot();
+	}
+
+	PlayerControllers.Reset();
+	SpatializedActors.Reset();
+	OtherActors.Reset();
+	World = nullptr;
+	NetDriver = nullptr;
+	Graph = nullptr;
+}
+
+FVector FLocusReplicationBenchmark::RandomLocation()
+{
+	return FVector(Random.FRandRange(-Settings.WorldExtent, Settings.WorldExtent), Random.FRandRange(-Settings.WorldExtent, Settings.WorldExtent), 0.f);
+}
+
+APlayerController* FLocusReplicationBenchmark::AddConnection(const FVector& Location)
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	APlayerController* PlayerController = World->SpawnActor<APlayerController>(Location, FRotator::ZeroRotator, SpawnParams);
+
+	USimulatedClientNetConnection* Connection = NewObject<USimulatedClientNetConnection>(NetDriver);
+	Connection->InitConnection(NetDriver, USOCK_Open, World->URL, 1000000);
+	Connection->InitSendBuffer();
+	Connection->PlayerController = PlayerController;
+	Connection->OwningActor = PlayerController;
+	Connection->ViewTarget = PlayerController;
+	PlayerController->Player = Connection;
+	PlayerController->NetConnection = Connection;
+
+	NetDriver->AddClientConnection(Connection);
+	NetDriver->AddNetworkActor(PlayerController);
+	PlayerControllers.Add(PlayerController);
+	return PlayerController;
+}
+
+void FLocusReplicationBenchmark::RemoveConnection(APlayerController* PlayerController)
+{
+	if (!PlayerController || !PlayerControllers.RemoveSwap(PlayerController))
+	{
+		return;
+	}
+
+	//cleanup destroys the PlayerController, graph has to forget it first
+	UNetConnection* Connection = PlayerController->NetConnection;
+	NetDriver->NotifyActorDestroyed(PlayerController);
+	if (Connection)
+	{
+		Connection->CleanUp();
+	}
+}
+
+AActor* FLocusReplicationBenchmark::SpawnActor(UClass* Class, const FVector& Location, AActor* Owner)
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = Owner;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AActor* Actor = World->SpawnActor<AActor>(Class, Location, FRotator::ZeroRotator, SpawnParams);
+
+	//world has no context, so it doesn't tell net driver by itself
+	if (Actor)
+	{
+		NetDriver->AddNetworkActor(Actor);
+	}
+	return Actor;
+}
+
+void FLocusReplicationBenchmark::DestroyActor(AActor* Actor)
+{
+	if (Actor)
+	{
+		NetDriver->NotifyActorDestroyed(Actor);
+		World->DestroyActor(Actor);
+	}
+}
+
+void FLocusReplicationBenchmark::Populate()
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	for (int32 Index = 0; Index < Settings.NumConnections; ++Index)
+	{
+		APlayerController* PlayerController = AddConnection(RandomLocation());
+		if (Settings.NumTeams > 0)
+		{
+			Graph->SetTeamForPlayerController(PlayerController, FName(*FString::Printf(TEXT("Team%d"), Index % Settings.NumTeams)));
+		}
+
+		for (int32 OwnerIndex = 0; OwnerIndex < Settings.NumOwnerActorsPerConnection; ++OwnerIndex)
+		{
+			OtherActors.Add(SpawnActor(ALocusBenchmarkOwnerActor::StaticClass(), PlayerController->GetActorLocation(), PlayerController));
+		}
+		for (int32 TeamIndex = 0; TeamIndex < Settings.NumTeamActorsPerConnection; ++TeamIndex)
+		{
+			OtherActors.Add(SpawnActor(ALocusBenchmarkTeamActor::StaticClass(), PlayerController->GetActorLocation(), PlayerController));
+		}
+	}
+
+	for (int32 Index = 0; Index < Settings.NumSpatializedActors; ++Index)
+	{
+		SpatializedActors.Add(SpawnActor(ALocusBenchmarkSpatializedActor::StaticClass(), RandomLocation()));
+	}
+
+	for (int32 Index = 0; Index < Settings.NumDependentActors && SpatializedActors.Num() > 0; ++Index)
+	{
+		AActor* Replicator = SpatializedActors[Random.RandHelper(SpatializedActors.Num())];
+		AActor* Dependent = SpawnActor(ALocusBenchmarkDependentActor::StaticClass(), Replicator->GetActorLocation());
+		Graph->AddDependentActor(Replicator, Dependent);
+		OtherActors.Add(Dependent);
+	}
+
+	SetupMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	NumSetupActors = Settings.NumConnections * (1 + Settings.NumOwnerActorsPerConnection + Settings.NumTeamActorsPerConnection) + Settings.NumSpatializedActors + Settings.NumDependentActors;
+}
+
+void FLocusReplicationBenchmark::MoveActors()
+{
+	const float Step = Settings.MoveSpeed * Settings.DeltaSeconds;
+	auto Wander = [&](AActor* Actor)
+	{
+		FVector Location = Actor->GetActorLocation() + FVector(Random.FRandRange(-Step, Step), Random.FRandRange(-Step, Step), 0.f);
+		Location.X = FMath::Clamp(Location.X, -Settings.WorldExtent, Settings.WorldExtent);
+		Location.Y = FMath::Clamp(Location.Y, -Settings.WorldExtent, Settings.WorldExtent);
+		Actor->SetActorLocation(Location);
+	};
+
+	for (AActor* Actor : SpatializedActors)
+	{
+		Wander(Actor);
+	}
+	for (APlayerController* PlayerController : PlayerControllers)
+	{
+		Wander(PlayerController);
+	}
+}
+
+void FLocusReplicationBenchmark::ReplicateFrame(float DeltaSeconds)
+{
+	if (DeltaSeconds <= 0.f)
+	{
+		DeltaSeconds = Settings.DeltaSeconds;
+	}
+
+	FLocusReplicationGraphStats& Stats = Graph->Stats;
+
+	//routing happens between frames, before graph samples it's stats
+	RouteMs.Add(FPlatformTime::ToMilliseconds64(Stats.RouteAddCycles + Stats.RouteRemoveCycles));
+
+	World->TimeSeconds += DeltaSeconds;
+	World->RealTimeSeconds += DeltaSeconds;
+	const double StartTime = FPlatformTime::Seconds();
+	NetDriver->ServerReplicateActors(DeltaSeconds);
+	ReplicateMs.Add((FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+	//graph reset it's accumulators at start of this frame, so they hold this frame only
+	PendingMs.Add(FPlatformTime::ToMilliseconds64(Stats.PendingCycles));
+	for (int32 StatIndex = 0; StatIndex < (int32)ELocusGatherStat::Num; ++StatIndex)
+	{
+		GatherMs[StatIndex].Add(FPlatformTime::ToMilliseconds64(Stats.GatherCycles[StatIndex]));
+	}
+}
+
+void FLocusReplicationBenchmark::Run()
+{
+	Populate();
+	//first frame routes pending entries and opens channels, keep it out of the run
+	ReplicateFrame();
+	ReplicateMs.Reset();
+	RouteMs.Reset();
+	PendingMs.Reset();
+	for (FLocusStatBuffer& Buffer : GatherMs)
+	{
+		Buffer.Reset();
+	}
+	UsedMemoryAfterSetup = FPlatformMemory::GetStats().UsedPhysical;
+
+	for (int32 Frame = 0; Frame < Settings.NumFrames; ++Frame)
+	{
+		MoveActors();
+
+		for (int32 Churn = 0; Churn < Settings.ChurnPerFrame && SpatializedActors.Num() > 0; ++Churn)
+		{
+			const int32 Index = Random.RandHelper(SpatializedActors.Num());
+			DestroyActor(SpatializedActors[Index]);
+			SpatializedActors[Index] = SpawnActor(ALocusBenchmarkSpatializedActor::StaticClass(), RandomLocation());
+		}
+
+		ReplicateFrame();
+	}
+	UsedMemoryAfterRun = FPlatformMemory::GetStats().UsedPhysical;
+
+	//disconnect burst, removal itself and the frame that compacts connection lists
+	NumDisconnected = FMath::Min(Settings.NumDisconnects, PlayerControllers.Num());
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumDisconnected; ++Index)
+	{
+		RemoveConnection(PlayerControllers.Last());
+	}
+	DisconnectMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	World->TimeSeconds += Settings.DeltaSeconds;
+	World->RealTimeSeconds += Settings.DeltaSeconds;
+	const double FrameStartTime = FPlatformTime::Seconds();
+	NetDriver->ServerReplicateActors(Settings.DeltaSeconds);
+	DisconnectFrameMs = (FPlatformTime::Seconds() - FrameStartTime) * 1000.0;
+}
+
+static TSharedRef<FJsonObject> MakeStatJson(const FLocusStatBuffer& Buffer)
+{
+	TSharedRef<FJsonObject> Json = MakeShared<FJsonObject>();
+	Json->SetNumberField(TEXT("avg"), Buffer.GetAverage());
+	Json->SetNumberField(TEXT("p50"), Buffer.GetPercentile(0.5f));
+	Json->SetNumberField(TEXT("p95"), Buffer.GetPercentile(0.95f));
+	Json->SetNumberField(TEXT("p99"), Buffer.GetPercentile(0.99f));
+	Json->SetNumberField(TEXT("max"), Buffer.GetMax());
+	return Json;
+}
+
+TSharedRef<FJsonObject> FLocusReplicationBenchmark::GetResults() const
+{
+	TSharedRef<FJsonObject> Results = MakeShared<FJsonObject>();
+	Results->SetStringField(TEXT("graph"), Graph ? Graph->GetClass()->GetPathName() : FString());
+	Results->SetStringField(TEXT("engine"), FEngineVersion::Current().ToString());
+
+	TSharedRef<FJsonObject> SettingsJson = MakeShared<FJsonObject>();
+	SettingsJson->SetNumberField(TEXT("connections"), Settings.NumConnections);
+	SettingsJson->SetNumberField(TEXT("teams"), Settings.NumTeams);
+	SettingsJson->SetNumberField(TEXT("spatialized_actors"), Settings.NumSpatializedActors);
+	SettingsJson->SetNumberField(TEXT("owner_actors_per_connection"), Settings.NumOwnerActorsPerConnection);
+	SettingsJson->SetNumberField(TEXT("team_actors_per_connection"), Settings.NumTeamActorsPerConnection);
+	SettingsJson->SetNumberField(TEXT("dependent_actors"), Settings.NumDependentActors);
+	SettingsJson->SetNumberField(TEXT("frames"), Settings.NumFrames);
+	SettingsJson->SetNumberField(TEXT("churn_per_frame"), Settings.ChurnPerFrame);
+	SettingsJson->SetNumberField(TEXT("world_extent"), Settings.WorldExtent);
+	SettingsJson->SetNumberField(TEXT("seed"), Settings.RandomSeed);
+	Results->SetObjectField(TEXT("settings"), SettingsJson);
+
+	TSharedRef<FJsonObject> SetupJson = MakeShared<FJsonObject>();
+	SetupJson->SetNumberField(TEXT("actors"), NumSetupActors);
+	SetupJson->SetNumberField(TEXT("spawn_and_route_ms"), SetupMs);
+	Results->SetObjectField(TEXT("setup"), SetupJson);
+
+	TSharedRef<FJsonObject> FramesJson = MakeShared<FJsonObject>();
+	FramesJson->SetObjectField(TEXT("replicate_ms"), MakeStatJson(ReplicateMs));
+	FramesJson->SetObjectField(TEXT("route_ms"), MakeStatJson(RouteMs));
+	FramesJson->SetObjectField(TEXT("pending_ms"), MakeStatJson(PendingMs));
+	TSharedRef<FJsonObject> GatherJson = MakeShared<FJsonObject>();
+	for (int32 StatIndex = 0; StatIndex < (int32)ELocusGatherStat::Num; ++StatIndex)
+	{
+		GatherJson->SetObjectField(LexToString((ELocusGatherStat)StatIndex), MakeStatJson(GatherMs[StatIndex]));
+	}
+	FramesJson->SetObjectField(TEXT("gather_ms"), GatherJson);
+	Results->SetObjectField(TEXT("frames"), FramesJson);
+
+	TSharedRef<FJsonObject> DisconnectJson = MakeShared<FJsonObject>();
+	DisconnectJson->SetNumberField(TEXT("connections"), NumDisconnected);
+	DisconnectJson->SetNumberField(TEXT("remove_ms"), DisconnectMs);
+	DisconnectJson->SetNumberField(TEXT("next_frame_ms"), DisconnectFrameMs);
+	Results->SetObjectField(TEXT("disconnect_burst"), DisconnectJson);
+
+	const double BytesToMB = 1.0 / (1024.0 * 1024.0);
+	TSharedRef<FJsonObject> MemoryJson = MakeShared<FJsonObject>();
+	MemoryJson->SetNumberField(TEXT("used_at_start_mb"), UsedMemoryAtStart * BytesToMB);
+	MemoryJson->SetNumberField(TEXT("used_after_setup_mb"), UsedMemoryAfterSetup * BytesToMB);
+	MemoryJson->SetNumberField(TEXT("used_after_run_mb"), UsedMemoryAfterRun * BytesToMB);
+	MemoryJson->SetNumberField(TEXT("peak_used_mb"), FPlatformMemory::GetStats().PeakUsedPhysical * BytesToMB);
+	Results->SetObjectField(TEXT("memory"), MemoryJson);
+
+	return Results;
+}
+
+void FLocusReplicationBenchmark::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	Collector.AddReferencedObject(World);
+	Collector.AddReferencedObject(NetDriver);
+	Collector.AddReferencedObject(Graph);
+	Collector.AddReferencedObjects(PlayerControllers);
+	Collector.AddReferencedObjects(SpatializedActors);
+	Collector.AddReferencedObjects(OtherActors);
+}
@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LocusReplicationBenchmarkCommandlet.h"
+#include "LocusReplicationBenchmark.h"
+#include "LocusReplicationGraph.h"
+#include "LocusReplicationTrace.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+ULocusReplicationBenchmarkCommandlet::ULocusReplicationBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = true;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 ULocusReplicationBenchmarkCommandlet::Main(const FString& Params)
+{
+	FLocusBenchmarkSettings Settings;
+	FString GraphClassPath;
+	FString OutputFilename;
+	FString TraceFilename;
+
+	FParse::Value(*Params, TEXT("Graph="), GraphClassPath);
+	FParse::Value(*Params, TEXT("Connections="), Settings.NumConnections);
+	FParse::Value(*Params, TEXT("Teams="), Settings.NumTeams);
+	FParse::Value(*Params, TEXT("Spatialized="), Settings.NumSpatializedActors);
+	FParse::Value(*Params, TEXT("OwnerActors="), Settings.NumOwnerActorsPerConnection);
+	FParse::Value(*Params, TEXT("TeamActors="), Settings.NumTeamActorsPerConnection);
+	FParse::Value(*Params, TEXT("Dependents="), Settings.NumDependentActors);
+	FParse::Value(*Params, TEXT("Frames="), Settings.NumFrames);
+	FParse::Value(*Params, TEXT("Churn="), Settings.ChurnPerFrame);
+	FParse::Value(*Params, TEXT("Disconnects="), Settings.NumDisconnects);
+	FParse::Value(*Params, TEXT("Extent="), Settings.WorldExtent);
+	FParse::Value(*Params, TEXT("Seed="), Settings.RandomSeed);
+	FParse::Value(*Params, TEXT("Output="), OutputFilename);
+	FParse::Value(*Params, TEXT("Trace="), TraceFilename);
+	Settings.NumConnections = FMath::Max(Settings.NumConnections, 1);
+	Settings.NumFrames = FMath::Max(Settings.NumFrames, 1);
+	Settings.WorldExtent = FMath::Max(Settings.WorldExtent, 1000.f);
+
+	//replay runs traced graph unless another one is given
+	FLocusTraceReplay Replay;
+	if (!TraceFilename.IsEmpty())
+	{
+		if (!Replay.Load(TraceFilename))
+		{
+			return 1;
+		}
+		if (GraphClassPath.IsEmpty())
+		{
+			GraphClassPath = Replay.GetGraphClassPath();
+		}
+		Settings.NumFrames = Replay.GetNumFrames() > 0 ? Replay.GetNumFrames() : 1 << 20;
+		Settings.SpatialBounds = Replay.GetSpatialBounds();
+	}
+
+	if (!GraphClassPath.IsEmpty())
+	{
+		Settings.GraphClass = LoadClass<ULocusReplicationGraph>(nullptr, *GraphClassPath);
+		if (!Settings.GraphClass)
+		{
+			UE_LOG(LogLocusReplicationGraph, Error, TEXT("Could not load LocusReplicationGraph class %s"), *GraphClassPath);
+			return 1;
+		}
+	}
+
+	FLocusReplicationBenchmark Benchmark;
+	if (!Benchmark.Init(Settings))
+	{
+		return 1;
+	}
+
+	TSharedPtr<FJsonObject> Results;
+	if (!TraceFilename.IsEmpty())
+	{
+		UE_LOG(LogLocusReplicationGraph, Display, TEXT("Replaying trace %s"), *TraceFilename);
+		const bool bReplayed = Replay.Run(Benchmark);
+		Results = Benchmark.GetResults();
+		//synthetic population parts don't apply to a replay
+		Results->RemoveField(TEXT("settings"));
+		Results->RemoveField(TEXT("setup"));
+		Results->RemoveField(TEXT("disconnect_burst"));
+		Results->SetObjectField(TEXT("trace"), Replay.GetResults());
+		if (!bReplayed)
+		{
+			Benchmark.Shutdown();
+			return 1;
+		}
+	}
+	else
+	{
+		UE_LOG(LogLocusReplicationGraph, Display, TEXT("Benchmarking %d connections, %d spatialized actors for %d frames"), Settings.NumConnections, Settings.NumSpatializedActors, Settings.NumFrames);
+		Benchmark.Run();
+		Results = Benchmark.GetResults();
+	}
+
+	FString ResultsString;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ResultsString);
+	FJsonSerializer::Serialize(Results.ToSharedRef(), Writer);
+	Benchmark.Shutdown();
+
+	if (OutputFilename.IsEmpty())
+	{
+		UE_LOG(LogLocusReplicationGraph, Display, TEXT("%s"), *ResultsString);
+	}
+	else if (!FFileHelper::SaveStringToFile(ResultsString, *OutputFilename))
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Could not write benchmark results to %s"), *OutputFilename);
+		return 1;
+	}
+	else
+	{
+		UE_LOG(LogLocusReplicationGraph, Display, TEXT("Wrote benchmark results to %s"), *OutputFilename);
+	}
+
+	return 0;
+}
@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "LocusReplicationBenchmarkCommandlet.generated.h"
+
+/**
+ * Runs FLocusReplicationBenchmark headless and writes it's results as JSON.
+ * Usage: -run=LocusReplicationBenchmark [-Graph=/Game/Path/BP_RepGraph.BP_RepGraph_C] [-Connections=100] [-Teams=4] [-Spatialized=5000]
+ *        [-OwnerActors=4] [-TeamActors=2] [-Dependents=500] [-Frames=300] [-Churn=10] [-Disconnects=20] [-Extent=100000] [-Seed=1] [-Output=Results.json]
+ * With -Trace=Saved/LocusTraces/Map.lrtrace a trace recorded by LocusRepGraph.Trace is replayed instead of the synthetic population.
+ */
+UCLASS()
+class ULocusReplicationBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	ULocusReplicationBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -1,7 +1,14 @@
 
 #include "LocusReplicationGraph.h"
 #include "Engine/LevelScriptActor.h"
+#include "Engine/LevelBounds.h"
+#include "Engine/ChildConnection.h"
+#include "Engine/NetworkObjectList.h"
+#include "LocusReplicationRoutingTable.h"
 #include "Runtime/Engine/Classes/Kismet/KismetSystemLibrary.h"
+#include "Async/ParallelFor.h"
+#include "Misc/Paths.h"
+#include "ProfilingDebugging/CsvProfiler.h"
 
 #if WITH_GAMEPLAY_DEBUGGER
 #include "GameplayDebuggerCategoryReplicator.h"
@@ -9,6 +16,29 @@
 
 DEFINE_LOG_CATEGORY(LogLocusReplicationGraph);
 
+DECLARE_CYCLE_STAT(TEXT("Route Add"), STAT_LocusRepGraph_RouteAdd, STATGROUP_LocusReplicationGraph);
+DECLARE_CYCLE_STAT(TEXT("Route Remove"), STAT_LocusRepGraph_RouteRemove, STATGROUP_LocusReplicationGraph);
+DECLARE_CYCLE_STAT(TEXT("Pending Actors And Team Requests"), STAT_LocusRepGraph_HandlePending, STATGROUP_LocusReplicationGraph);
+DECLARE_CYCLE_STAT(TEXT("Team Gather"), STAT_LocusRepGraph_TeamGather, STATGROUP_LocusReplicationGraph);
+DECLARE_CYCLE_STAT(TEXT("View Follow Gather"), STAT_LocusRepGraph_ViewFollowGather, STATGROUP_LocusReplicationGraph);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pending actors"), STAT_LocusRepGraph_PendingActors, STATGROUP_LocusReplicationGraph);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pending owners"), STAT_LocusRepGraph_PendingOwners, STATGROUP_LocusReplicationGraph);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Teams"), STAT_LocusRepGraph_Teams, STATGROUP_LocusReplicationGraph);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Max team size"), STAT_LocusRepGraph_MaxTeamSize, STATGROUP_LocusReplicationGraph);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Max connection actors"), STAT_LocusRepGraph_MaxConnectionActors, STATGROUP_LocusReplicationGraph);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Max connection gather ms"), STAT_LocusRepGraph_MaxConnectionGatherMs, STATGROUP_LocusReplicationGraph);
+
+CSV_DEFINE_CATEGORY(LocusRepGraph, true);
+
+static TAutoConsoleVariable<int32> CVarLocusParallelGather(TEXT("LocusRepGraph.ParallelGather"), 1,
+	TEXT("Cull owner spatialized nodes of all connections as parallel tasks before gather."), ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarLocusVerifyParallelGather(TEXT("LocusRepGraph.VerifyParallelGather"), 0,
+	TEXT("Cull again serially during gather and log when result differs from parallel cull."), ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarLocusTraceMoveThreshold(TEXT("LocusRepGraph.TraceMoveThreshold"), 50.f,
+	TEXT("Traced actors moving less than this since their last record are not written."), ECVF_Default);
+
 
 ULocusReplicationGraph::ULocusReplicationGraph()
 {
@@ -25,17 +55,22 @@ ULocusReplicationGraph::ULocusReplicationGraph()
 	ReplicationInfoSettings.Add(PawnClassRepInfo);
 }
 
-void InitClassReplicationInfo(FClassReplicationInfo& Info, UClass* Class, bool bSpatialize, float ServerMaxTickRate)
+void InitClassReplicationInfo(FClassReplicationInfo& Info, UClass* Class, bool bSpatialize, float ServerMaxTickRate, bool bLog)
 {
 	AActor* CDO = Class->GetDefaultObject<AActor>();
 	if (bSpatialize)
 	{
 		Info.SetCullDistanceSquared(CDO->NetCullDistanceSquared);
-		UE_LOG(LogLocusReplicationGraph, Log, TEXT("Setting cull distance for %s to %f (%f)"), *Class->GetName(), Info.GetCullDistanceSquared(), FMath::Sqrt(Info.GetCullDistanceSquared()));
+		UE_CLOG(bLog, LogLocusReplicationGraph, Log, TEXT("Setting cull distance for %s to %f (%f)"), *Class->GetName(), Info.GetCullDistanceSquared(), FMath::Sqrt(Info.GetCullDistanceSquared()));
 	}
 
 	Info.ReplicationPeriodFrame = FMath::Max<uint32>((uint32)FMath::RoundToFloat(ServerMaxTickRate / CDO->NetUpdateFrequency), 1);
 
+	if (!bLog)
+	{
+		return;
+	}
+
 	UClass* NativeClass = Class;
 	while (!NativeClass->IsNative() && NativeClass->GetSuperClass() && NativeClass->GetSuperClass() != AActor::StaticClass())
 	{
@@ -45,6 +80,21 @@ void InitClassReplicationInfo(FClassReplicationInfo& Info, UClass* Class, bool b
 	UE_LOG(LogLocusReplicationGraph, Log, TEXT("Setting replication period for %s (%s) to %d frames (%.2f)"), *Class->GetName(), *NativeClass->GetName(), Info.ReplicationPeriodFrame, CDO->NetUpdateFrequency);
 }
 
+//walk up net owner chain to the actor that eventually holds NetConnection(usually a PlayerController)
+AActor* GetTopNetOwner(AActor* Actor)
+{
+	AActor* TopOwner = Actor;
+	while (const AActor* NextOwner = TopOwner->GetNetOwner())
+	{
+		if (NextOwner == TopOwner)
+		{
+			break;
+		}
+		TopOwner = const_cast<AActor*>(NextOwner);
+	}
+	return TopOwner;
+}
+
 const UClass* GetParentNativeClass(const UClass* Class)
 {
 	while (Class && !Class->IsNative())
@@ -59,18 +109,160 @@ void ULocusReplicationGraph::InitGlobalActorClassSettings()
 {
 	Super::InitGlobalActorClassSettings();
 
+	//baked table first, dynamic pass below only handles classes missing from it
+	TSet<const UClass*> BakedClasses;
+	if (!RoutingTable.IsNull())
+	{
+		if (ULocusReplicationRoutingTable* Table = RoutingTable.LoadSynchronous())
+		{
+			ApplyRoutingTable(Table, NetDriver->NetServerMaxTickRate, BakedClasses);
+		}
+		else
+		{
+			UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Failed to load routing table %s, every class will be resolved dynamically"), *RoutingTable.ToString());
+		}
+	}
+
+	TArray<UClass*> AllReplicatedClasses;
+	ResolveClassSettings(NetDriver->NetServerMaxTickRate, BakedClasses, AllReplicatedClasses);
+
+	UReplicationGraphNode_ActorListFrequencyBuckets::DefaultSettings.ListSize = FrequencyBucketActorsPerFrame;
+
+	// Bake resolved policy of every replicated class, classes loaded later are cached lazily
+	ClassPolicyTable.Reset();
+	auto CachePolicy = [&](const UClass* Class)
+	{
+		const EClassRepNodeMapping* PolicyPtr = ClassRepNodePolicies.Get(const_cast<UClass*>(Class));
+		ClassPolicyTable.Set(Class, PolicyPtr ? *PolicyPtr : EClassRepNodeMapping::NotRouted);
+	};
+	for (const UClass* BakedClass : BakedClasses)
+	{
+		CachePolicy(BakedClass);
+	}
+	for (UClass* ReplicatedClass : AllReplicatedClasses)
+	{
+		CachePolicy(ReplicatedClass);
+	}
+	if (!PostGarbageCollectHandle.IsValid())
+	{
+		PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &ULocusReplicationGraph::OnPostGarbageCollect);
+	}
+
+	// Print out what we came up with
+	if (bLogClassSettings)
+	{
+		LogClassSettings();
+	}
+
+	// Rep destruct infos based on CVar value
+	DestructInfoMaxDistanceSquared = DestructionInfoMaxDistance * DestructionInfoMaxDistance;
+
+#if WITH_GAMEPLAY_DEBUGGER
+	AGameplayDebuggerCategoryReplicator::NotifyDebuggerOwnerChange.AddUObject(this, &ULocusReplicationGraph::OnGameplayDebuggerOwnerChange);
+#endif
+}
+
+//engine classes routed regardless of their flags, presets override them
+static const TArray<TPair<UClass*, EClassRepNodeMapping>>& GetNativeClassPolicies()
+{
+	static TArray<TPair<UClass*, EClassRepNodeMapping>> NativePolicies;
+	if (NativePolicies.Num() == 0)
+	{
+		NativePolicies.Emplace(AReplicationGraphDebugActor::StaticClass(),			EClassRepNodeMapping::NotRouted);				// Not needed. Replicated special case inside RepGraph
+		NativePolicies.Emplace(AInfo::StaticClass(),								EClassRepNodeMapping::RelevantAllConnections);	// Non spatialized, relevant to all
+		NativePolicies.Emplace(ALevelScriptActor::StaticClass(),					EClassRepNodeMapping::NotRouted);				// Not needed
+		NativePolicies.Emplace(APlayerController::StaticClass(),					EClassRepNodeMapping::RelevantOwnerConnection);	// Owner should always see it's controller
+#if WITH_GAMEPLAY_DEBUGGER
+		NativePolicies.Emplace(AGameplayDebuggerCategoryReplicator::StaticClass(),	EClassRepNodeMapping::RelevantOwnerConnection);	// Only owner connection viable
+#endif
+	}
+	return NativePolicies;
+}
+
+bool ULocusReplicationGraph::ResolveDefaultPolicy(UClass* Class, EClassRepNodeMapping& OutPolicy) const
+{
+	for (const TPair<UClass*, EClassRepNodeMapping>& NativePolicy : GetNativeClassPolicies())
+	{
+		if (NativePolicy.Key == Class)
+		{
+			OutPolicy = NativePolicy.Value;
+			return true;
+		}
+	}
+
+	AActor* ActorCDO = Cast<AActor>(Class->GetDefaultObject());
+	if (!ActorCDO || !ActorCDO->GetIsReplicated())
+	{
+		return false;
+	}
+
+	auto ShouldSpatialize = [](const AActor* CDO)
+	{
+		return CDO->GetIsReplicated() && (!(CDO->bAlwaysRelevant || CDO->bOnlyRelevantToOwner || CDO->bNetUseOwnerRelevancy));
+	};
+
+	// Only handle this class if it differs from its super. There is no need to put every child class explicitly in the graph class mapping
+	UClass* SuperClass = Class->GetSuperClass();
+	if (AActor* SuperCDO = Cast<AActor>(SuperClass->GetDefaultObject()))
+	{
+		if (SuperCDO->GetIsReplicated() == ActorCDO->GetIsReplicated()
+			&& SuperCDO->bAlwaysRelevant == ActorCDO->bAlwaysRelevant
+			&&	SuperCDO->bOnlyRelevantToOwner == ActorCDO->bOnlyRelevantToOwner
+			&&	SuperCDO->bNetUseOwnerRelevancy == ActorCDO->bNetUseOwnerRelevancy
+			)
+		{
+			//same settings with superclass, ignore this class
+			return false;
+		}
+	}
+
+	if (ShouldSpatialize(ActorCDO))
+	{
+		OutPolicy = EClassRepNodeMapping::Spatialize_Dynamic;
+		return true;
+	}
+	else if (ActorCDO->bAlwaysRelevant && !ActorCDO->bOnlyRelevantToOwner)
+	{
+		OutPolicy = EClassRepNodeMapping::RelevantAllConnections;
+		return true;
+	}
+	else if (ActorCDO->bOnlyRelevantToOwner)
+	{
+		//!bAlwaysRelevant && bOnlyRelevantToOwner -> only owner see this but is spatialized
+		OutPolicy = bSpatializeOwnerOnlyActors && !ActorCDO->bAlwaysRelevant ? EClassRepNodeMapping::RelevantOwnerConnection_Spatialized : EClassRepNodeMapping::RelevantOwnerConnection;
+		return true;
+	}
+	return false;
+}
+
+//walk up super chain to nearest preset, duplicated or set included child will be ignored
+static bool IsCoveredByInfoPreset(const UClass* Class, const TMap<const UClass*, const FClassReplicationInfoPreset*>& Presets)
+{
+	for (const UClass* PresetClass = Class; PresetClass; PresetClass = PresetClass->GetSuperClass())
+	{
+		if (const FClassReplicationInfoPreset* const* Preset = Presets.Find(PresetClass))
+		{
+			if (PresetClass == Class || (*Preset)->IncludeChildClasses)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void ULocusReplicationGraph::ResolveClassSettings(float ServerMaxTickRate, const TSet<const UClass*>& ResolvedClasses, TArray<UClass*>& OutReplicatedClasses)
+{
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	// Programatically build the rules.
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
 	auto AddInfo = [&](UClass* Class, EClassRepNodeMapping Mapping) { ClassRepNodePolicies.Set(Class, Mapping); };
 
-	AddInfo(AReplicationGraphDebugActor::StaticClass(),			EClassRepNodeMapping::NotRouted);				// Not needed. Replicated special case inside RepGraph
-	AddInfo(AInfo::StaticClass(),								EClassRepNodeMapping::RelevantAllConnections);	// Non spatialized, relevant to all
-	AddInfo(ALevelScriptActor::StaticClass(),					EClassRepNodeMapping::NotRouted);				// Not needed
-#if WITH_GAMEPLAY_DEBUGGER
-	AddInfo(AGameplayDebuggerCategoryReplicator::StaticClass(), EClassRepNodeMapping::RelevantOwnerConnection);	// Only owner connection viable
-#endif
+	for (const TPair<UClass*, EClassRepNodeMapping>& NativePolicy : GetNativeClassPolicies())
+	{
+		AddInfo(NativePolicy.Key, NativePolicy.Value);
+	}
 
 	for (FClassReplicationPolicyPreset PolicyBP : ReplicationPolicySettings)
 	{
@@ -82,12 +274,19 @@ void ULocusReplicationGraph::InitGlobalActorClassSettings()
 
 	//this does contains all replicated class except GetIsReplicated is false actor
 	//if someone need to make replication work, mark it as replicated and control it over replication graph
-	TArray<UClass*> AllReplicatedClasses;
+	TArray<UClass*>& AllReplicatedClasses = OutReplicatedClasses;
 
 	//Iterate all class
 	for (TObjectIterator<UClass> It; It; ++It)
 	{
 		UClass* Class = *It;
+
+		// Skip classes that are already resolved(baked)
+		if (ResolvedClasses.Contains(Class))
+		{
+			continue;
+		}
+
 		AActor* ActorCDO = Cast<AActor>(Class->GetDefaultObject());
 
 		if (!ActorCDO || !ActorCDO->GetIsReplicated())
@@ -96,7 +295,8 @@ void ULocusReplicationGraph::InitGlobalActorClassSettings()
 		}
 
 		// Skip SKEL and REINST classes.
-		if (Class->GetName().StartsWith(TEXT("SKEL_")) || Class->GetName().StartsWith(TEXT("REINST_")))
+		const FString ClassName = Class->GetName();
+		if (ClassName.StartsWith(TEXT("SKEL_")) || ClassName.StartsWith(TEXT("REINST_")))
 		{
 			continue;
 		}
@@ -113,81 +313,44 @@ void ULocusReplicationGraph::InitGlobalActorClassSettings()
 			continue;
 		}
 
-		auto ShouldSpatialize = [](const AActor* CDO)
-		{
-			return CDO->GetIsReplicated() && (!(CDO->bAlwaysRelevant || CDO->bOnlyRelevantToOwner || CDO->bNetUseOwnerRelevancy));
-		};
-
-		auto GetLegacyDebugStr = [](const AActor* CDO)
-		{
-			return FString::Printf(TEXT("%s [%d/%d/%d]"), *CDO->GetClass()->GetName(), CDO->bAlwaysRelevant, CDO->bOnlyRelevantToOwner, CDO->bNetUseOwnerRelevancy);
-		};
-
-		// Only handle this class if it differs from its super. There is no need to put every child class explicitly in the graph class mapping
-		UClass* SuperClass = Class->GetSuperClass();
-		if (AActor* SuperCDO = Cast<AActor>(SuperClass->GetDefaultObject()))
-		{
-			if (SuperCDO->GetIsReplicated() == ActorCDO->GetIsReplicated()
-				&& SuperCDO->bAlwaysRelevant == ActorCDO->bAlwaysRelevant
-				&&	SuperCDO->bOnlyRelevantToOwner == ActorCDO->bOnlyRelevantToOwner
-				&&	SuperCDO->bNetUseOwnerRelevancy == ActorCDO->bNetUseOwnerRelevancy
-				)
-			{
-				//same settings with superclass, ignore this class
-				continue;
-			}
-		}
-
-		if (ShouldSpatialize(ActorCDO))
+		EClassRepNodeMapping Policy;
+		if (ResolveDefaultPolicy(Class, Policy))
 		{
-			AddInfo(Class, EClassRepNodeMapping::Spatialize_Dynamic);
+			AddInfo(Class, Policy);
 		}
-		else if (ActorCDO->bAlwaysRelevant && !ActorCDO->bOnlyRelevantToOwner)
-		{
-			AddInfo(Class, EClassRepNodeMapping::RelevantAllConnections);
-		}
-		else if (ActorCDO->bOnlyRelevantToOwner)
-		{
-			AddInfo(Class, EClassRepNodeMapping::RelevantOwnerConnection);
-		}
-
-		//TODO:: currently missing feature, !bAlwaysRelevant && bOnlyRelevantToOwner -> only owner see this but is spatialized
 	}
 
-	TArray<FClassReplicationInfoPreset> ValidClassReplicationInfoPreset;
-	//custom setting
+	//custom setting, first preset of a class wins
+	TMap<const UClass*, const FClassReplicationInfoPreset*> ValidClassReplicationInfoPreset;
 	for (FClassReplicationInfoPreset& ReplicationInfoBP : ReplicationInfoSettings)
 	{
-		if (ReplicationInfoBP.Class)
+		if (ReplicationInfoBP.Class && !ValidClassReplicationInfoPreset.Contains(ReplicationInfoBP.Class.Get()))
 		{
 			GlobalActorReplicationInfoMap.SetClassInfo(ReplicationInfoBP.Class, ReplicationInfoBP.CreateClassReplicationInfo());
-			ValidClassReplicationInfoPreset.Add(ReplicationInfoBP);
+			ValidClassReplicationInfoPreset.Add(ReplicationInfoBP.Class.Get(), &ReplicationInfoBP);
+			ClassVerticalCullDistances.Set(ReplicationInfoBP.Class, ReplicationInfoBP.VerticalCullDistance);
+			ClassAdaptivePeriods.Add(ReplicationInfoBP.Class.Get(), { ReplicationInfoBP.AdaptiveReplicationPeriod, ReplicationInfoBP.IncludeChildClasses });
 		}
 	}
 
-	UReplicationGraphNode_ActorListFrequencyBuckets::DefaultSettings.ListSize = 12;
-
 	// Set FClassReplicationInfo based on legacy settings from all replicated classes
 	for (UClass* ReplicatedClass : AllReplicatedClasses)
 	{
-		if (FClassReplicationInfoPreset* Preset = ValidClassReplicationInfoPreset.FindByPredicate([&](const FClassReplicationInfoPreset& Info) { return ReplicatedClass->IsChildOf(Info.Class.Get());  }))
+		if (IsCoveredByInfoPreset(ReplicatedClass, ValidClassReplicationInfoPreset))
 		{
-			//duplicated or set included child will be ignored
-			if (Preset->Class.Get() == ReplicatedClass || Preset->IncludeChildClasses)
-			{
-				continue;
-			}
+			continue;
 		}
 
-		const bool bClassIsSpatialized = IsSpatialized(ClassRepNodePolicies.GetChecked(ReplicatedClass));
+		const bool bClassIsSpatialized = UsesCullDistance(ClassRepNodePolicies.GetChecked(ReplicatedClass));
 
 		FClassReplicationInfo ClassInfo;
-		InitClassReplicationInfo(ClassInfo, ReplicatedClass, bClassIsSpatialized, NetDriver->NetServerMaxTickRate);
+		InitClassReplicationInfo(ClassInfo, ReplicatedClass, bClassIsSpatialized, ServerMaxTickRate, bLogClassSettings);
 		GlobalActorReplicationInfoMap.SetClassInfo(ReplicatedClass, ClassInfo);
 	}
+}
 
-
-	// Print out what we came up with
+void ULocusReplicationGraph::LogClassSettings()
+{
 	UE_LOG(LogLocusReplicationGraph, Log, TEXT(""));
 	UE_LOG(LogLocusReplicationGraph, Log, TEXT("Class Routing Map: "));
 	UEnum* Enum = FindObject<UEnum>(ANY_PACKAGE, TEXT("EClassRepNodeMapping"));
@@ -215,493 +378,2525 @@ void ULocusReplicationGraph::InitGlobalActorClassSettings()
 		const FClassReplicationInfo& ClassInfo = ClassRepInfoIt.Value();
 		UE_LOG(LogLocusReplicationGraph, Log, TEXT("  %s (%s) -> %s"), *Class->GetName(), *GetNameSafe(GetParentNativeClass(Class)), *ClassInfo.BuildDebugStringDelta());
 	}
-
-
-	// Rep destruct infos based on CVar value
-	DestructInfoMaxDistanceSquared = DestructionInfoMaxDistance * DestructionInfoMaxDistance;
-
-#if WITH_GAMEPLAY_DEBUGGER
-	AGameplayDebuggerCategoryReplicator::NotifyDebuggerOwnerChange.AddUObject(this, &ULocusReplicationGraph::OnGameplayDebuggerOwnerChange);
-#endif
 }
 
-void ULocusReplicationGraph::InitGlobalGraphNodes()
+//exported text of every preset, so fields added to presets later are hashed too
+template<typename PresetType>
+static uint32 HashPresets(const TArray<PresetType>& Presets, uint32 Hash)
 {
-	// Preallocate some replication lists. comment the following 4 lines in case you use UE5+
-	PreAllocateRepList(3, 12);
-	PreAllocateRepList(6, 12);
-	PreAllocateRepList(128, 64);
-	PreAllocateRepList(512, 16);
-
-	// -----------------------------------------------
-	//	Spatial Actors
-	// -----------------------------------------------
-
-	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
-	GridNode->CellSize = SpacialCellSize;
-	GridNode->SpatialBias = SpatialBias;
-
-	if (!EnableSpatialRebuilds)
+	for (const PresetType& Preset : Presets)
 	{
-		GridNode->AddSpatialRebuildBlacklistClass(AActor::StaticClass()); // Disable All spatial rebuilding
+		FString PresetText;
+		PresetType::StaticStruct()->ExportText(PresetText, &Preset, nullptr, nullptr, PPF_None, nullptr);
+		Hash = FCrc::StrCrc32(*PresetText, Hash);
 	}
+	return Hash;
+}
 
-	AddGlobalGraphNode(GridNode);
-
-	// -----------------------------------------------
-	//	Always Relevant (to everyone) Actors
-	// -----------------------------------------------
-	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_WithPending>();
-	AddGlobalGraphNode(AlwaysRelevantNode);
+uint32 ULocusReplicationGraph::GetClassSettingsHash() const
+{
+	uint32 Hash = HashPresets(ReplicationPolicySettings, 0);
+	Hash = HashPresets(ReplicationInfoSettings, Hash);
+	return HashCombine(Hash, bSpatializeOwnerOnlyActors ? 1 : 0);
 }
 
-void ULocusReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+void ULocusReplicationGraph::ApplyRoutingTable(const ULocusReplicationRoutingTable* Table, float ServerMaxTickRate, TSet<const UClass*>& OutBakedClasses)
 {
-	Super::InitConnectionGraphNodes(RepGraphConnection);
+	//replication periods are baked with tick rate, stale table is worse than dynamic pass
+	if (!FMath::IsNearlyEqual(Table->BakedServerMaxTickRate, ServerMaxTickRate))
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Routing table %s was baked with tick rate %.1f but server runs %.1f, ignoring it. Rebake the table."), *Table->GetName(), Table->BakedServerMaxTickRate, ServerMaxTickRate);
+		return;
+	}
 
-	//UE_LOG(LogLocusReplicationGraph, Warning, TEXT("InitConnection : %s"), *RepGraphConnection->NetConnection->PlayerController->GetName());
-	ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(RepGraphConnection);
-	if (!LocusConnManager)
+	//child classes are baked with explicit entries, edited presets would never reach them
+	if (Table->BakedSettingsHash != GetClassSettingsHash())
 	{
-		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Unrecognized ConnectionDriver class, Expected ULocusReplicationConnectionGraph"));
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Routing table %s was baked with different replication presets or settings, ignoring it. Rebake the table."), *Table->GetName());
+		return;
 	}
 
-	LocusConnManager->AlwaysRelevantForConnectionNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
-	AddConnectionGraphNode(LocusConnManager->AlwaysRelevantForConnectionNode, RepGraphConnection);
+	for (const FLocusBakedClassRouting& Entry : Table->Classes)
+	{
+		//classes that are not loaded are not needed now
+		UClass* Class = Entry.Class.Get();
+		if (!Class)
+		{
+			continue;
+		}
 
-	LocusConnManager->TeamConnectionNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForTeam>();
-	AddConnectionGraphNode(LocusConnManager->TeamConnectionNode, RepGraphConnection);
+		ClassRepNodePolicies.Set(Class, Entry.Policy);
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, Entry.CreateClassReplicationInfo());
+		OutBakedClasses.Add(Class);
+	}
 
-	//don't care about team names as it's initial value is always  NAME_None
+	UE_LOG(LogLocusReplicationGraph, Log, TEXT("Applied %d of %d classes from routing table %s"), OutBakedClasses.Num(), Table->Classes.Num(), *Table->GetName());
 }
 
-void ULocusReplicationGraph::OnRemoveConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+void ULocusReplicationGraph::BakeRoutingTable(ULocusReplicationRoutingTable* Table, float ServerMaxTickRate)
 {
-	ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(RepGraphConnection);
-	if (LocusConnManager)
+	TArray<UClass*> AllReplicatedClasses;
+	ResolveClassSettings(ServerMaxTickRate, TSet<const UClass*>(), AllReplicatedClasses);
+
+	Table->BakedServerMaxTickRate = ServerMaxTickRate;
+	Table->BakedSettingsHash = GetClassSettingsHash();
+	Table->Classes.Reset(AllReplicatedClasses.Num());
+	for (UClass* ReplicatedClass : AllReplicatedClasses)
 	{
-		if (LocusConnManager->TeamName != NAME_None)
-		{
-			TeamConnectionListMap.RemoveConnectionFromTeam(LocusConnManager->TeamName, LocusConnManager);
-		}
+		const EClassRepNodeMapping* PolicyPtr = ClassRepNodePolicies.Get(ReplicatedClass);
+
+		FLocusBakedClassRouting& Entry = Table->Classes.AddDefaulted_GetRef();
+		Entry.Class = ReplicatedClass;
+		Entry.Policy = PolicyPtr ? *PolicyPtr : EClassRepNodeMapping::NotRouted;
+		Entry.SetClassReplicationInfo(GlobalActorReplicationInfoMap.GetClassInfo(ReplicatedClass));
 	}
 }
 
-void ULocusReplicationGraph::RemoveClientConnection(UNetConnection* NetConnection)
+//classes whose effective preset was added, changed or removed. policies: last preset of a class wins, infos: first one
+template<typename PresetType>
+static void CollectChangedPresetClasses(const TArray<PresetType>& OldPresets, const TArray<PresetType>& NewPresets, bool bFirstWins, TSet<const UClass*>& OutClasses)
 {
-	//we completely override super function
-
-	int32 ConnectionId = 0;
-	bool bFound = false;
-
-	// Remove the RepGraphConnection associated with this NetConnection. Also update ConnectionIds to stay compact.
-	auto UpdateList = [&](TArray<UNetReplicationGraphConnection*> List)
+	auto GetEffectivePresets = [bFirstWins](const TArray<PresetType>& Presets)
 	{
-		for (int32 idx = 0; idx < Connections.Num(); ++idx)
+		TMap<const UClass*, const PresetType*> EffectivePresets;
+		for (const PresetType& Preset : Presets)
 		{
-			UNetReplicationGraphConnection* ConnectionManager = Connections[idx];
-			repCheck(ConnectionManager);
-
-			if (ConnectionManager->NetConnection == NetConnection)
-			{
-				ensure(!bFound);
-				//Nofity this to handle something - remove from team list
-				OnRemoveConnectionGraphNodes(ConnectionManager);
-				Connections.RemoveAtSwap(idx, 1, false);
-				bFound = true;
-			}
-			else
+			if (Preset.Class && (!bFirstWins || !EffectivePresets.Contains(Preset.Class.Get())))
 			{
-				ConnectionManager->ConnectionOrderNum = ConnectionId++;
+				EffectivePresets.Add(Preset.Class.Get(), &Preset);
 			}
 		}
+		return EffectivePresets;
 	};
 
-	UpdateList(Connections);
-	UpdateList(PendingConnections);
-
-	if (!bFound)
+	const TMap<const UClass*, const PresetType*> OldEffective = GetEffectivePresets(OldPresets);
+	const TMap<const UClass*, const PresetType*> NewEffective = GetEffectivePresets(NewPresets);
+	for (const auto& OldPair : OldEffective)
 	{
-		// At least one list should have found the connection
-		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("UReplicationGraph::RemoveClientConnection could not find connection in Connection (%d) or PendingConnections (%d) lists"), *GetNameSafe(NetConnection), Connections.Num(), PendingConnections.Num());
+		const PresetType* const* NewPreset = NewEffective.Find(OldPair.Key);
+		if (!NewPreset || !PresetType::StaticStruct()->CompareScriptStruct(OldPair.Value, *NewPreset, PPF_None))
+		{
+			OutClasses.Add(OldPair.Key);
+		}
+	}
+	for (const auto& NewPair : NewEffective)
+	{
+		if (!OldEffective.Contains(NewPair.Key))
+		{
+			OutClasses.Add(NewPair.Key);
+		}
 	}
 }
 
-void ULocusReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+static bool IsChildOfAny(const UClass* Class, const TSet<const UClass*>& Roots)
 {
-	EClassRepNodeMapping Policy = GetMappingPolicy(ActorInfo.Class);
-	switch (Policy)
-	{
-	case EClassRepNodeMapping::NotRouted:
+	for (const UClass* SuperClass = Class; SuperClass; SuperClass = SuperClass->GetSuperClass())
 	{
-		break;
+		if (Roots.Contains(SuperClass))
+		{
+			return true;
+		}
 	}
+	return false;
+}
 
-	case EClassRepNodeMapping::RelevantAllConnections:
+void ULocusReplicationGraph::ApplyClassSettings(const TArray<FClassReplicationPolicyPreset>& NewPolicySettings, const TArray<FClassReplicationInfoPreset>& NewInfoSettings)
+{
+	TSet<const UClass*> PolicyRoots;
+	CollectChangedPresetClasses(ReplicationPolicySettings, NewPolicySettings, false, PolicyRoots);
+	TSet<const UClass*> InfoRoots;
+	CollectChangedPresetClasses(ReplicationInfoSettings, NewInfoSettings, true, InfoRoots);
+	//infos without preset depend on policy, cull distance is only set for spatialized classes
+	InfoRoots.Append(PolicyRoots);
+
+	if (InfoRoots.Num() == 0)
 	{
-		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
-		break;
+		UE_LOG(LogLocusReplicationGraph, Log, TEXT("ApplyClassSettings: nothing changed"));
+		return;
 	}
 
-	case EClassRepNodeMapping::RelevantOwnerConnection:
-	case EClassRepNodeMapping::RelevantTeamConnection:
+	//live actors of affected classes. spatialized ones are binned by cull distance, so they are rerouted even if policy stays
+	struct FAffectedActor
 	{
-		RouteAddNetworkActorToConnectionNodes(Policy, ActorInfo, GlobalInfo);
-		break;
-	}
-
-	case EClassRepNodeMapping::Spatialize_Static:
+		AActor* Actor;
+		EClassRepNodeMapping OldPolicy;
+		bool bReroute;
+	};
+	TArray<FAffectedActor> AffectedActors;
+	for (const TSharedPtr<FNetworkObjectInfo>& ObjectInfo : NetDriver->GetNetworkObjectList().GetAllObjects())
 	{
-		GridNode->AddActor_Static(ActorInfo, GlobalInfo);
-		break;
-	}
+		AActor* Actor = ObjectInfo.IsValid() ? ObjectInfo->Actor : nullptr;
+		if (!Actor || Actor->IsPendingKill() || !GlobalActorReplicationInfoMap.Find(Actor) || !IsChildOfAny(Actor->GetClass(), InfoRoots))
+		{
+			continue;
+		}
 
-	case EClassRepNodeMapping::Spatialize_Dynamic:
-	{
-		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
-		break;
+		const EClassRepNodeMapping OldPolicy = GetMappingPolicy(Actor->GetClass());
+		AffectedActors.Add({ Actor, OldPolicy, IsChildOfAny(Actor->GetClass(), PolicyRoots) || IsSpatialized(OldPolicy) });
 	}
 
-	case EClassRepNodeMapping::Spatialize_Dormancy:
+	//batched removal with old policy and old infos, nodes find actors where they were put
+	int32 NumRerouted = 0;
+	for (const FAffectedActor& Affected : AffectedActors)
 	{
-		GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
-		break;
+		if (Affected.bReroute)
+		{
+			RouteRemoveActorWithPolicy(Affected.OldPolicy, FNewReplicatedActorInfo(Affected.Actor));
+			++NumRerouted;
+		}
 	}
-	};
-}
-
-void ULocusReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
-{
-	EClassRepNodeMapping Policy = GetMappingPolicy(ActorInfo.Class);
 
-	switch (Policy)
-	{
-	case EClassRepNodeMapping::NotRouted:
-	{
-		break;
-	}
+	ReplicationPolicySettings = NewPolicySettings;
+	ReplicationInfoSettings = NewInfoSettings;
+	UpdateClassSettings(PolicyRoots, InfoRoots);
 
-	case EClassRepNodeMapping::RelevantAllConnections:
+	//actor infos copy class info when they are created, update them in place
+	for (const FAffectedActor& Affected : AffectedActors)
+	{
+		FGlobalActorReplicationInfo& GlobalInfo = *GlobalActorReplicationInfoMap.Find(Affected.Actor);
+		GlobalInfo.Settings = GlobalActorReplicationInfoMap.GetClassInfo(Affected.Actor->GetClass());
+		if (IsAdaptivePeriodClass(Affected.Actor->GetClass()))
+		{
+			AdaptivePeriodActors.Add(Affected.Actor);
+		}
+		else
+		{
+			AdaptivePeriodActors.Remove(Affected.Actor);
+		}
+		if (const FLocusActorReplicationOverride* Override = ActorOverrides.Find(Affected.Actor))
+		{
+			Override->ApplyTo(GlobalInfo.Settings);
+		}
+
+		for (UNetReplicationGraphConnection* ConnManager : Connections)
+		{
+			if (FConnectionReplicationActorInfo* ConnectionInfo = ConnManager->ActorInfoMap.Find(Affected.Actor))
+			{
+				ConnectionInfo->ReplicationPeriodFrame = FMath::Max<uint32>(GlobalInfo.Settings.ReplicationPeriodFrame, 1);
+				ConnectionInfo->SetCullDistanceSquared(GlobalInfo.Settings.GetCullDistanceSquared());
+				ConnectionInfo->ActorChannelFrameTimeout = GlobalInfo.Settings.ActorChannelFrameTimeout;
+			}
+		}
+
+		if (Affected.bReroute)
+		{
+			RouteAddActorWithPolicy(GetMappingPolicy(Affected.Actor->GetClass()), FNewReplicatedActorInfo(Affected.Actor), GlobalInfo);
+		}
+	}
+
+	//periods were reset to class values above
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager);
+		if (LocusConnManager && LocusConnManager->ReplicationPeriodMultiplier > 1)
+		{
+			ApplyReplicationPeriodMultiplier(LocusConnManager);
+		}
+	}
+
+	UE_LOG(LogLocusReplicationGraph, Log, TEXT("ApplyClassSettings: %d policy and %d info preset classes changed, %d actors updated, %d rerouted"),
+		PolicyRoots.Num(), InfoRoots.Num(), AffectedActors.Num(), NumRerouted);
+}
+
+void ULocusReplicationGraph::UpdateClassSettings(const TSet<const UClass*>& PolicyRoots, const TSet<const UClass*>& InfoRoots)
+{
+	//drop explicit and cached policies under changed classes, then resolve them again like startup does
+	TSet<UClass*> PolicyClasses;
+	for (const UClass* Root : PolicyRoots)
+	{
+		PolicyClasses.Add(const_cast<UClass*>(Root));
+	}
+	for (auto It = ClassRepNodePolicies.CreateIterator(); It; ++It)
+	{
+		UClass* Class = Cast<UClass>(It.Key().ResolveObjectPtr());
+		if (Class && IsChildOfAny(Class, PolicyRoots))
+		{
+			PolicyClasses.Add(Class);
+			It.RemoveCurrent();
+		}
+	}
+
+	TSet<const UClass*> PresetClasses;
+	for (const FClassReplicationPolicyPreset& PolicyBP : ReplicationPolicySettings)
+	{
+		if (PolicyBP.Class && PolicyClasses.Contains(PolicyBP.Class.Get()))
+		{
+			ClassRepNodePolicies.Set(PolicyBP.Class, PolicyBP.Policy);
+			PresetClasses.Add(PolicyBP.Class.Get());
+		}
+	}
+	for (UClass* Class : PolicyClasses)
+	{
+		EClassRepNodeMapping Policy;
+		if (!PresetClasses.Contains(Class) && ResolveDefaultPolicy(Class, Policy))
+		{
+			ClassRepNodePolicies.Set(Class, Policy);
+		}
+	}
+
+	//cached policies are refilled lazily
+	ClassPolicyTable.Reset();
+
+	TMap<const UClass*, const FClassReplicationInfoPreset*> ValidClassReplicationInfoPreset;
+	ClassVerticalCullDistances = TClassMap<float>();
+	ClassAdaptivePeriods.Reset();
+	for (const FClassReplicationInfoPreset& ReplicationInfoBP : ReplicationInfoSettings)
+	{
+		if (ReplicationInfoBP.Class && !ValidClassReplicationInfoPreset.Contains(ReplicationInfoBP.Class.Get()))
+		{
+			ValidClassReplicationInfoPreset.Add(ReplicationInfoBP.Class.Get(), &ReplicationInfoBP);
+			ClassVerticalCullDistances.Set(ReplicationInfoBP.Class, ReplicationInfoBP.VerticalCullDistance);
+			ClassAdaptivePeriods.Add(ReplicationInfoBP.Class.Get(), { ReplicationInfoBP.AdaptiveReplicationPeriod, ReplicationInfoBP.IncludeChildClasses });
+		}
+	}
+
+	TSet<UClass*> InfoClasses;
+	for (const UClass* Root : InfoRoots)
+	{
+		InfoClasses.Add(const_cast<UClass*>(Root));
+	}
+	for (auto It = GlobalActorReplicationInfoMap.CreateClassMapIterator(); It; ++It)
+	{
+		UClass* Class = Cast<UClass>(It.Key().ResolveObjectPtr());
+		if (Class && IsChildOfAny(Class, InfoRoots))
+		{
+			InfoClasses.Add(Class);
+			It.RemoveCurrent();
+		}
+	}
+
+	for (UClass* Class : InfoClasses)
+	{
+		if (const FClassReplicationInfoPreset* const* Preset = ValidClassReplicationInfoPreset.Find(Class))
+		{
+			GlobalActorReplicationInfoMap.SetClassInfo(Class, (*Preset)->CreateClassReplicationInfo());
+			continue;
+		}
+
+		//children covered by a preset inherit it's class info
+		AActor* ActorCDO = Cast<AActor>(Class->GetDefaultObject());
+		if (!ActorCDO || !ActorCDO->GetIsReplicated() || IsCoveredByInfoPreset(Class, ValidClassReplicationInfoPreset))
+		{
+			continue;
+		}
+
+		const EClassRepNodeMapping* Policy = ClassRepNodePolicies.Get(Class);
+		FClassReplicationInfo ClassInfo;
+		InitClassReplicationInfo(ClassInfo, Class, Policy && UsesCullDistance(*Policy), NetDriver->NetServerMaxTickRate, bLogClassSettings);
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, ClassInfo);
+	}
+}
+
+void ULocusReplicationGraph::ReloadClassSettings()
+{
+	const ULocusReplicationGraph* Defaults = GetClass()->GetDefaultObject<ULocusReplicationGraph>();
+	ApplyClassSettings(Defaults->ReplicationPolicySettings, Defaults->ReplicationInfoSettings);
+}
+
+FClassReplicationInfoPreset ULocusReplicationGraph::GetClassInfoPreset(UClass* Class)
+{
+	for (const FClassReplicationInfoPreset& ReplicationInfoBP : ReplicationInfoSettings)
+	{
+		if (ReplicationInfoBP.Class == Class)
+		{
+			return ReplicationInfoBP;
+		}
+	}
+
+	//new preset starts from what class currently uses
+	const FClassReplicationInfo& ClassInfo = GlobalActorReplicationInfoMap.GetClassInfo(Class);
+	const float* VerticalCullDistance = ClassVerticalCullDistances.Get(Class);
+
+	FClassReplicationInfoPreset Preset;
+	Preset.Class = Class;
+	Preset.DistancePriorityScale = ClassInfo.DistancePriorityScale;
+	Preset.StarvationPriorityScale = ClassInfo.StarvationPriorityScale;
+	Preset.CullDistanceSquared = ClassInfo.GetCullDistanceSquared();
+	Preset.VerticalCullDistance = VerticalCullDistance ? *VerticalCullDistance : 0.f;
+	Preset.ReplicationPeriodFrame = (uint8)FMath::Clamp<uint32>(ClassInfo.ReplicationPeriodFrame, 1, MAX_uint8);
+	Preset.ActorChannelFrameTimeout = ClassInfo.ActorChannelFrameTimeout;
+	Preset.AdaptiveReplicationPeriod = IsAdaptivePeriodClass(Class);
+	return Preset;
+}
+
+bool ULocusReplicationGraph::SetActorCullDistanceOverride(AActor* Actor, float CullDistance)
+{
+	const float CullDistanceSquared = FMath::Square(FMath::Max(CullDistance, 0.f));
+	return SetActorOverride(Actor, FLocusActorReplicationOverride::CullDistance, [CullDistanceSquared](FLocusActorReplicationOverride& Override)
+	{
+		Override.CullDistanceSquared = CullDistanceSquared;
+	});
+}
+
+bool ULocusReplicationGraph::SetActorReplicationPeriodOverride(AActor* Actor, int32 ReplicationPeriodFrame)
+{
+	const uint16 PeriodFrame = (uint16)FMath::Clamp<int32>(ReplicationPeriodFrame, 1, MAX_uint16);
+	return SetActorOverride(Actor, FLocusActorReplicationOverride::ReplicationPeriod, [PeriodFrame](FLocusActorReplicationOverride& Override)
+	{
+		Override.ReplicationPeriodFrame = PeriodFrame;
+	});
+}
+
+bool ULocusReplicationGraph::SetActorPriorityScaleOverride(AActor* Actor, float DistancePriorityScale, float StarvationPriorityScale)
+{
+	return SetActorOverride(Actor, FLocusActorReplicationOverride::PriorityScale, [DistancePriorityScale, StarvationPriorityScale](FLocusActorReplicationOverride& Override)
+	{
+		Override.DistancePriorityScale = FMath::Max(DistancePriorityScale, 0.f);
+		Override.StarvationPriorityScale = FMath::Max(StarvationPriorityScale, 0.f);
+	});
+}
+
+void ULocusReplicationGraph::ClearActorReplicationOverrides(AActor* Actor)
+{
+	if (Actor && ActorOverrides.Remove(Actor))
+	{
+		RefreshActorReplicationInfo(Actor);
+	}
+}
+
+bool ULocusReplicationGraph::SetActorOverride(AActor* Actor, uint8 Fields, TFunctionRef<void(FLocusActorReplicationOverride&)> Setter)
+{
+	if (!Actor || !GlobalActorReplicationInfoMap.Find(Actor))
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Can't override replication info of %s, it is not replicated by %s"), *GetNameSafe(Actor), *GetName());
+		return false;
+	}
+
+	FLocusActorReplicationOverride& Override = ActorOverrides.FindOrAdd(Actor);
+	Override.Fields |= Fields;
+	Setter(Override);
+	RefreshActorReplicationInfo(Actor);
+	return true;
+}
+
+void ULocusReplicationGraph::RefreshActorReplicationInfo(AActor* Actor)
+{
+	FGlobalActorReplicationInfo* GlobalInfo = GlobalActorReplicationInfoMap.Find(Actor);
+	if (!GlobalInfo)
+	{
+		return;
+	}
+
+	FClassReplicationInfo Settings = GlobalActorReplicationInfoMap.GetClassInfo(Actor->GetClass());
+	if (const FLocusActorReplicationOverride* Override = ActorOverrides.Find(Actor))
+	{
+		Override->ApplyTo(Settings);
+	}
+
+	//grid and voxel cells are picked from cull distance when actor is added, so remove with old distance and add back to the same node
+	const EClassRepNodeMapping Policy = GetMappingPolicy(Actor->GetClass());
+	const bool bRebin = IsSpatialized(Policy) && Settings.GetCullDistanceSquared() != GlobalInfo->Settings.GetCullDistanceSquared();
+	if (bRebin)
+	{
+		RouteRemoveActorWithPolicy(Policy, FNewReplicatedActorInfo(Actor));
+	}
+
+	GlobalInfo->Settings = Settings;
+
+	//connection infos copied settings when they were created
+	const bool bAdaptive = AdaptivePeriodActors.Contains(Actor);
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		if (FConnectionReplicationActorInfo* ConnectionInfo = ConnManager->ActorInfoMap.Find(Actor))
+		{
+			const ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager);
+			const int32 Multiplier = bAdaptive && LocusConnManager ? LocusConnManager->ReplicationPeriodMultiplier : 1;
+			ConnectionInfo->ReplicationPeriodFrame = FMath::Max<uint32>(Settings.ReplicationPeriodFrame, 1) * Multiplier;
+			ConnectionInfo->SetCullDistanceSquared(Settings.GetCullDistanceSquared());
+		}
+	}
+
+	if (bRebin)
+	{
+		RouteAddActorWithPolicy(Policy, FNewReplicatedActorInfo(Actor), *GlobalInfo);
+	}
+}
+
+void ULocusReplicationGraph::PrintActorOverrides()
+{
+	TArray<const AActor*> Actors;
+	ActorOverrides.GetActors(Actors);
+	GLog->Logf(TEXT("%s : %d actor overrides, pool of %d"), *GetName(), Actors.Num(), ActorOverrides.GetPoolSize());
+
+	for (const AActor* Actor : Actors)
+	{
+		const FLocusActorReplicationOverride& Override = *ActorOverrides.Find(Actor);
+		FString Fields;
+		if (Override.Fields & FLocusActorReplicationOverride::CullDistance)
+		{
+			Fields += FString::Printf(TEXT(" CullDistance=%.0f"), FMath::Sqrt(Override.CullDistanceSquared));
+		}
+		if (Override.Fields & FLocusActorReplicationOverride::ReplicationPeriod)
+		{
+			Fields += FString::Printf(TEXT(" ReplicationPeriodFrame=%d"), Override.ReplicationPeriodFrame);
+		}
+		if (Override.Fields & FLocusActorReplicationOverride::PriorityScale)
+		{
+			Fields += FString::Printf(TEXT(" DistancePriorityScale=%.2f StarvationPriorityScale=%.2f"), Override.DistancePriorityScale, Override.StarvationPriorityScale);
+		}
+		GLog->Logf(TEXT("  %s%s"), *GetNameSafe(Actor), *Fields);
+	}
+}
+
+void ULocusReplicationGraph::InitGlobalGraphNodes()
+{
+	// Preallocate some replication lists. comment the following 4 lines in case you use UE5+
+	PreAllocateRepList(3, 12);
+	PreAllocateRepList(6, 12);
+	PreAllocateRepList(128, 64);
+	PreAllocateRepList(512, 16);
+
+	// -----------------------------------------------
+	//	Spatial Actors
+	// -----------------------------------------------
+
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D_Layered>();
+	InitGridNode(GridNode);
+
+	AddGlobalGraphNode(GridNode);
+
+	VoxelNode = CreateNewNode<UReplicationGraphNode_VoxelSpatialization3D>();
+	VoxelNode->CellSize = VoxelCellSize;
+	VoxelNode->VerticalCellSize = VoxelVerticalCellSize;
+	AddGlobalGraphNode(VoxelNode);
+
+	TeamVisionNode = CreateNewNode<UReplicationGraphNode_TeamVision>();
+	AddGlobalGraphNode(TeamVisionNode);
+
+	PVSNode = CreateNewNode<UReplicationGraphNode_PVS>();
+	AddGlobalGraphNode(PVSNode);
+
+	ViewFollowNode = CreateNewNode<UReplicationGraphNode_ViewFollow>();
+	AddGlobalGraphNode(ViewFollowNode);
+
+	// -----------------------------------------------
+	//	Always Relevant (to everyone) Actors
+	// -----------------------------------------------
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_WithPending>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+}
+
+void ULocusReplicationGraph::InitGridNode(UReplicationGraphNode_GridSpatialization2D_Layered* Grid) const
+{
+	TArray<float> LayerCellSizes = SpatialLayerCellSizes;
+	LayerCellSizes.AddUnique(SpacialCellSize);
+
+	Grid->InitLayers(LayerCellSizes, SpatialBias, EnableSpatialRebuilds, SpatialLayerCullDistanceInCells);
+	Grid->OutOfBoundsCheckInterval = OutOfBoundsCheckInterval;
+	Grid->AutoPathStillTime = GridPathStillTime;
+	Grid->AutoPathMoveThreshold = GridPathMoveThreshold;
+
+	//team grids are created after world is initialized
+	if (GridNode && Grid != GridNode)
+	{
+		Grid->SetSpatialBounds(GridNode->GetSpatialBounds());
+	}
+}
+
+void ULocusReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	//UE_LOG(LogLocusReplicationGraph, Warning, TEXT("InitConnection : %s"), *RepGraphConnection->NetConnection->PlayerController->GetName());
+	ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(RepGraphConnection);
+	if (!LocusConnManager)
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Unrecognized ConnectionDriver class, Expected ULocusReplicationConnectionGraph"));
+	}
+
+	ConnectionSlots.Add(LocusConnManager);
+
+	if (TraceWriter)
+	{
+		TraceWriter->AddConnection(LocusConnManager);
+	}
+
+	LocusConnManager->AlwaysRelevantForConnectionNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(LocusConnManager->AlwaysRelevantForConnectionNode, RepGraphConnection);
+
+	LocusConnManager->TeamConnectionNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForTeam>();
+	AddConnectionGraphNode(LocusConnManager->TeamConnectionNode, RepGraphConnection);
+
+	LocusConnManager->OwnerSpatializedNode = CreateNewNode<UReplicationGraphNode_OwnerSpatialized>();
+	AddConnectionGraphNode(LocusConnManager->OwnerSpatializedNode, RepGraphConnection);
+
+	LocusConnManager->TeamSpatializedNode = CreateNewNode<UReplicationGraphNode_TeamSpatialized>();
+	AddConnectionGraphNode(LocusConnManager->TeamSpatializedNode, RepGraphConnection);
+
+	//don't care about team names as it's initial value is always  NAME_None
+
+	//connection may already have it's owner, resolve pending actors waiting for it
+	if (LocusConnManager->NetConnection && LocusConnManager->NetConnection->PlayerController)
+	{
+		UpdateConnectionPlayerController(LocusConnManager, LocusConnManager->NetConnection->PlayerController);
+	}
+}
+
+void ULocusReplicationGraph::OnRemoveConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(RepGraphConnection);
+	if (LocusConnManager)
+	{
+		if (LocusConnManager->TeamName != NAME_None)
+		{
+			RemoveConnectionFromTeam(LocusConnManager->TeamName, LocusConnManager);
+		}
+		ConnectionSlots.Remove(LocusConnManager);
+		ConnectionsByPlayerController.Remove(LocusConnManager->CachedPlayerController);
+		LocusConnManager->CachedPlayerController = nullptr;
+
+		if (TraceWriter)
+		{
+			TraceWriter->RemoveConnection(LocusConnManager);
+		}
+	}
+}
+
+//remove ConnManager from List, Hint is it's expected index. swapped in connection takes over it's order num
+static bool RemoveConnectionAtSwap(TArray<UNetReplicationGraphConnection*>& List, UNetReplicationGraphConnection* ConnManager, int32 Hint)
+{
+	const int32 Index = List.IsValidIndex(Hint) && List[Hint] == ConnManager ? Hint : List.Find(ConnManager);
+	if (Index == INDEX_NONE)
+	{
+		return false;
+	}
+
+	List.RemoveAtSwap(Index, 1, false);
+	if (List.IsValidIndex(Index))
+	{
+		List[Index]->ConnectionOrderNum = ConnManager->ConnectionOrderNum;
+	}
+	return true;
+}
+
+void ULocusReplicationGraph::RemoveClientConnection(UNetConnection* NetConnection)
+{
+	//we completely override super function
+
+	//initialized connection, ConnectionOrderNum is it's index while numbering is compact
+	if (ULocusReplicationConnectionGraph* LocusConnManager = ConnectionSlots.Find(NetConnection))
+	{
+		//Nofity this to handle something - remove from team list
+		OnRemoveConnectionGraphNodes(LocusConnManager);
+		LocusConnManager->bPendingRemoval = true;
+
+		const int32 OrderNum = LocusConnManager->ConnectionOrderNum;
+		if (RemoveConnectionAtSwap(Connections, LocusConnManager, OrderNum) || RemoveConnectionAtSwap(PendingConnections, LocusConnManager, OrderNum - Connections.Num()))
+		{
+			//pending connections are numbered after Connections, renumber once per frame
+			bConnectionListsDirty = true;
+		}
+		else
+		{
+			UE_LOG(LogLocusReplicationGraph, Warning, TEXT("UReplicationGraph::RemoveClientConnection could not find connection %s in Connection (%d) or PendingConnections (%d) lists"), *GetNameSafe(NetConnection), Connections.Num(), PendingConnections.Num());
+		}
+		return;
+	}
+
+	//not initialized yet, rare case. search both lists
+	bool bFound = false;
+	auto UpdateList = [&](TArray<UNetReplicationGraphConnection*>& List)
+	{
+		for (int32 idx = 0; idx < List.Num(); ++idx)
+		{
+			UNetReplicationGraphConnection* ConnectionManager = List[idx];
+			repCheck(ConnectionManager);
+
+			if (ConnectionManager->NetConnection == NetConnection)
+			{
+				ensure(!bFound);
+				OnRemoveConnectionGraphNodes(ConnectionManager);
+				List.RemoveAtSwap(idx, 1, false);
+				bConnectionListsDirty = true;
+				bFound = true;
+				return;
+			}
+		}
+	};
+
+	UpdateList(Connections);
+	if (!bFound)
+	{
+		UpdateList(PendingConnections);
+	}
+
+	if (!bFound)
+	{
+		// At least one list should have found the connection
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("UReplicationGraph::RemoveClientConnection could not find connection %s in Connection (%d) or PendingConnections (%d) lists"), *GetNameSafe(NetConnection), Connections.Num(), PendingConnections.Num());
+	}
+}
+
+void ULocusReplicationGraph::CompactConnectionLists()
+{
+	if (!bConnectionListsDirty)
+	{
+		return;
+	}
+	bConnectionListsDirty = false;
+
+	// Update ConnectionIds to stay compact.
+	int32 ConnectionId = 0;
+	for (UNetReplicationGraphConnection* ConnectionManager : Connections)
+	{
+		ConnectionManager->ConnectionOrderNum = ConnectionId++;
+	}
+	for (UNetReplicationGraphConnection* ConnectionManager : PendingConnections)
+	{
+		ConnectionManager->ConnectionOrderNum = ConnectionId++;
+	}
+}
+
+void ULocusReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LocusRepGraph_RouteAdd);
+	CSV_SCOPED_TIMING_STAT(LocusRepGraph, RouteAdd);
+	FLocusScopedStatCycles ScopedCycles(Stats.RouteAddCycles);
+	++Stats.NumRouteAdds;
+
+	if (TraceWriter)
+	{
+		TraceWriter->AddActor(ActorInfo.Actor, ActorInfo.Actor->GetOwner());
+	}
+
+	if (IsAdaptivePeriodClass(ActorInfo.Class))
+	{
+		AdaptivePeriodActors.Add(ActorInfo.Actor);
+	}
+
+	RouteAddActorWithPolicy(GetMappingPolicy(ActorInfo.Class), ActorInfo, GlobalInfo);
+}
+
+void ULocusReplicationGraph::RouteAddActorWithPolicy(EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	switch (Policy)
+	{
+	case EClassRepNodeMapping::NotRouted:
+	{
+		break;
+	}
+
+	case EClassRepNodeMapping::RelevantAllConnections:
+	{
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::RelevantOwnerConnection:
+	case EClassRepNodeMapping::RelevantTeamConnection:
+	case EClassRepNodeMapping::RelevantOwnerConnection_Spatialized:
+	case EClassRepNodeMapping::RelevantTeamConnection_Spatialized:
+	{
+		RouteAddNetworkActorToConnectionNodes(Policy, ActorInfo, GlobalInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::RelevantTeamVision:
+	{
+		TeamVisionNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::Spatialize_Static:
+	{
+		GridNode->AddActor_Static(ActorInfo, GlobalInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::Spatialize_Dynamic:
+	{
+		if (bAutoGridActorPaths)
+		{
+			GridNode->AddActor_Auto(ActorInfo, GlobalInfo);
+		}
+		else
+		{
+			GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+		}
+		break;
+	}
+
+	case EClassRepNodeMapping::Spatialize_Dormancy:
+	{
+		GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::Spatialize_3D:
+	{
+		const float* VerticalCullDistance = ClassVerticalCullDistances.Get(ActorInfo.Class);
+		VoxelNode->AddActor(ActorInfo, GlobalInfo, VerticalCullDistance ? *VerticalCullDistance : 0.f);
+		break;
+	}
+
+	case EClassRepNodeMapping::Spatialize_PVS:
+	{
+		//maps without baked table fall back to distance culling
+		if (PVSNode->HasTable())
+		{
+			PVSNode->NotifyAddNetworkActor(ActorInfo);
+		}
+		else
+		{
+			GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+		}
+		break;
+	}
+	};
+}
+
+void ULocusReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LocusRepGraph_RouteRemove);
+	CSV_SCOPED_TIMING_STAT(LocusRepGraph, RouteRemove);
+	FLocusScopedStatCycles ScopedCycles(Stats.RouteRemoveCycles);
+	++Stats.NumRouteRemoves;
+
+	if (TraceWriter)
+	{
+		TraceWriter->RemoveActor(ActorInfo.Actor);
+	}
+
+	DependencyGraph.RemoveActor(ActorInfo.Actor, [this](AActor* ReplicatorActor, AActor* DependentActor, bool bAdd) { SetEngineDependentActor(ReplicatorActor, DependentActor, bAdd); });
+	ActorOverrides.Remove(ActorInfo.Actor);
+	AdaptivePeriodActors.Remove(ActorInfo.Actor);
+
+	RouteRemoveActorWithPolicy(GetMappingPolicy(ActorInfo.Class), ActorInfo);
+}
+
+void ULocusReplicationGraph::RouteRemoveActorWithPolicy(EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo)
+{
+	switch (Policy)
+	{
+	case EClassRepNodeMapping::NotRouted:
+	{
+		break;
+	}
+
+	case EClassRepNodeMapping::RelevantAllConnections:
 	{
 		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
 		break;
 	}
 
-	case EClassRepNodeMapping::RelevantOwnerConnection:
-	case EClassRepNodeMapping::RelevantTeamConnection:
+	case EClassRepNodeMapping::RelevantOwnerConnection:
+	case EClassRepNodeMapping::RelevantTeamConnection:
+	case EClassRepNodeMapping::RelevantOwnerConnection_Spatialized:
+	case EClassRepNodeMapping::RelevantTeamConnection_Spatialized:
+	{
+		RouteRemoveNetworkActorToConnectionNodes(Policy, ActorInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::RelevantTeamVision:
+	{
+		TeamVisionNode->NotifyRemoveNetworkActor(ActorInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::Spatialize_Static:
+	{
+		GridNode->RemoveActor_Static(ActorInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::Spatialize_Dynamic:
+	{
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::Spatialize_Dormancy:
+	{
+		GridNode->RemoveActor_Dormancy(ActorInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::Spatialize_3D:
+	{
+		VoxelNode->RemoveActor(ActorInfo);
+		break;
+	}
+
+	case EClassRepNodeMapping::Spatialize_PVS:
+	{
+		if (!PVSNode->NotifyRemoveNetworkActor(ActorInfo, false))
+		{
+			GridNode->RemoveActor_Dynamic(ActorInfo);
+		}
+		break;
+	}
+	};
+}
+
+//this function will be called seamless map transition
+//as all actors will be removed in silly order, we have to deal with it
+void ULocusReplicationGraph::ResetGameWorldState()
+{
+	Super::ResetGameWorldState();
+
+	//all actor will be destroyed. just reset it.
+	PendingOwners.Reset();
+	PendingActorOwners.Reset();
+	DependencyGraph.Reset();
+	RoutedOwnerActors.Reset();
+	AdaptivePeriodActors.Reset();
+	OwnerCheckOrder.Reset();
+	NextOwnerCheck = 0;
+	QueuedOwnerChanges.Reset();
+	ActorOverrides.Reset();
+	#pragma warning(push)
+	#pragma warning(disable: 4458)
+	auto EmptyConnectionNode = [](TArray<UNetReplicationGraphConnection*>& Connections)
+	{
+		for (UNetReplicationGraphConnection* ConnManager : Connections)
+		{
+			if (ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager))
+			{
+				LocusConnManager->AlwaysRelevantForConnectionNode->NotifyResetAllNetworkActors();
+				LocusConnManager->TeamConnectionNode->NotifyResetAllNetworkActors();
+				LocusConnManager->OwnerSpatializedNode->NotifyResetAllNetworkActors();
+				LocusConnManager->TeamSpatializedNode->NotifyResetAllNetworkActors();
+			}
+		}
+	};
+	#pragma warning(pop)
+	EmptyConnectionNode(PendingConnections);
+	EmptyConnectionNode(Connections);
+
+	//as connection does not destroyed, we keep team membership but empty shared lists
+	for (auto& TeamNodePair : TeamSharedNodes)
+	{
+		TeamNodePair.Value->NotifyResetAllNetworkActors();
+		TeamNodePair.Value->TeamGridNode->NotifyResetAllNetworkActors();
+	}
+}
+
+void ULocusReplicationGraph::BeginDestroy()
+{
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+	PostGarbageCollectHandle.Reset();
+
+	Super::BeginDestroy();
+}
+
+void ULocusReplicationGraph::InitializeForWorld(UWorld* World)
+{
+	//trace header holds bounds of previous world, and it's actors are gone
+	StopTrace();
+
+	if (World && GridNode)
+	{
+		const FBox2D Bounds = ComputeSpatialBounds(World);
+		GridNode->SetSpatialBounds(Bounds);
+
+		//vision grid needs fixed bounds, fall back to area around default bias
+		TeamVisionNode->InitGrid(Bounds.bIsValid ? Bounds : FBox2D(SpatialBias, -SpatialBias), TeamVisionCellSize);
+
+		const FString PVSFilename = GetPVSFilename(UWorld::RemovePIEPrefix(World->GetMapName()));
+		if (!PVSNode->LoadTable(PVSFilename))
+		{
+			UE_LOG(LogLocusReplicationGraph, Log, TEXT("No PVS table at %s, Spatialize_PVS classes use distance culling"), *PVSFilename);
+		}
+
+		//team grids share layout with global grid
+		for (auto& TeamNodePair : TeamSharedNodes)
+		{
+			TeamNodePair.Value->TeamGridNode->SetSpatialBounds(Bounds);
+		}
+		for (UReplicationGraphNode_GridSpatialization2D_Layered* FreeGrid : FreeTeamGridNodes)
+		{
+			FreeGrid->SetSpatialBounds(Bounds);
+		}
+
+		if (Bounds.bIsValid)
+		{
+			UE_LOG(LogLocusReplicationGraph, Log, TEXT("Spatial bounds of %s: %s"), *World->GetMapName(), *Bounds.ToString());
+		}
+	}
+
+	//routes actors of the world, bounds have to be ready
+	Super::InitializeForWorld(World);
+}
+
+FBox2D ULocusReplicationGraph::ComputeSpatialBounds(UWorld* World) const
+{
+	FBox Bounds(ForceInit);
+
+	const FName MapName(*UWorld::RemovePIEPrefix(World->GetMapName()));
+	if (const FBox* OverrideBounds = SpatialBoundsOverrides.Find(MapName))
+	{
+		Bounds = *OverrideBounds;
+	}
+	else if (bAutoSpatialBounds)
+	{
+		for (ULevel* Level : World->GetLevels())
+		{
+			if (Level)
+			{
+				const FBox LevelBounds = ALevelBounds::CalculateLevelBounds(Level);
+				if (LevelBounds.IsValid)
+				{
+					Bounds += LevelBounds;
+				}
+			}
+		}
+
+		if (Bounds.IsValid)
+		{
+			Bounds = Bounds.ExpandBy(FVector(SpatialBoundsMargin, SpatialBoundsMargin, 0.f));
+		}
+	}
+
+	if (!Bounds.IsValid)
+	{
+		return FBox2D(ForceInit);
+	}
+	return FBox2D(FVector2D(Bounds.Min), FVector2D(Bounds.Max));
+}
+
+FString ULocusReplicationGraph::GetPVSFilename(const FString& MapName) const
+{
+	return FPaths::ProjectContentDir() / PVSDirectory / MapName + TEXT(".lpvs");
+}
+
+// Since we listen to global (static) events, we need to watch out for cross world broadcasts (PIE)
+#if WITH_EDITOR
+#define CHECK_WORLDS(X) if(X->GetWorld() != GetWorld()) return;
+#else
+#define CHECK_WORLDS(X)
+#endif
+
+void ULocusReplicationGraph::AddDependentActor(AActor* ReplicatorActor, AActor* DependentActor)
+{
+	if (ReplicatorActor && DependentActor)
+	{
+		CHECK_WORLDS(ReplicatorActor);
+
+		if (TraceWriter)
+		{
+			TraceWriter->SetDependentActor(ReplicatorActor, DependentActor, true);
+		}
+		DependencyGraph.QueueAdd(ReplicatorActor, DependentActor);
+	}
+}
+
+void ULocusReplicationGraph::RemoveDependentActor(AActor* ReplicatorActor, AActor* DependentActor)
+{
+	if (ReplicatorActor && DependentActor)
+	{
+		CHECK_WORLDS(ReplicatorActor);
+
+		if (TraceWriter)
+		{
+			TraceWriter->SetDependentActor(ReplicatorActor, DependentActor, false);
+		}
+		DependencyGraph.QueueRemove(ReplicatorActor, DependentActor);
+	}
+}
+
+void ULocusReplicationGraph::AddDependentActors(AActor* ReplicatorActor, const TArray<AActor*>& DependentActors)
+{
+	for (AActor* DependentActor : DependentActors)
+	{
+		AddDependentActor(ReplicatorActor, DependentActor);
+	}
+}
+
+void ULocusReplicationGraph::RemoveDependentActors(AActor* ReplicatorActor, const TArray<AActor*>& DependentActors)
+{
+	for (AActor* DependentActor : DependentActors)
+	{
+		RemoveDependentActor(ReplicatorActor, DependentActor);
+	}
+}
+
+void ULocusReplicationGraph::RemoveAllDependentActors(AActor* ReplicatorActor)
+{
+	if (ReplicatorActor)
+	{
+		CHECK_WORLDS(ReplicatorActor);
+
+		if (TraceWriter)
+		{
+			TraceWriter->SetDependentActor(ReplicatorActor, nullptr, false);
+		}
+		DependencyGraph.QueueRemoveAll(ReplicatorActor);
+	}
+}
+
+void ULocusReplicationGraph::GetDependentActors(AActor* ReplicatorActor, TArray<AActor*>& OutDependentActors, bool bTransitive) const
+{
+	DependencyGraph.GetDependents(ReplicatorActor, OutDependentActors, bTransitive);
+}
+
+void ULocusReplicationGraph::SetEngineDependentActor(AActor* ReplicatorActor, AActor* DependentActor, bool bAdd)
+{
+	if (bAdd)
+	{
+		GlobalActorReplicationInfoMap.AddDependentActor(ReplicatorActor, DependentActor);
+	}
+	else
+	{
+		GlobalActorReplicationInfoMap.RemoveDependentActor(ReplicatorActor, DependentActor);
+	}
+}
+
+void ULocusReplicationGraph::ApplyDependencyChanges()
+{
+	if (!DependencyGraph.HasPendingChanges())
+	{
+		return;
+	}
+
+	DependencyGraph.ApplyPendingChanges(
+		[this](AActor* ReplicatorActor) { return GlobalActorReplicationInfoMap.Find(ReplicatorActor) != nullptr; },
+		[this](AActor* ReplicatorActor, AActor* DependentActor, bool bAdd) { SetEngineDependentActor(ReplicatorActor, DependentActor, bAdd); });
+}
+
+void ULocusReplicationGraph::ChangeOwnerOfAnActor(AActor* ActorToChange, AActor* NewOwner)
+{
+	if (!ActorToChange)
+	{
+		return;
+	}
+
+	ActorToChange->SetOwner(NewOwner);
+
+	if (TraceWriter)
+	{
+		TraceWriter->ChangeOwner(ActorToChange, NewOwner);
+	}
+
+	//whole owned subtree is rerouted at next frame, so order of calls does not matter
+	QueuedOwnerChanges.Add(ActorToChange);
+}
+
+void ULocusReplicationGraph::AddVisionSource(AActor* Source, FName TeamName, float Radius)
+{
+	if (Source)
+	{
+		CHECK_WORLDS(Source);
+
+		TeamVisionNode->AddVisionSource(Source, TeamName, Radius);
+	}
+}
+
+void ULocusReplicationGraph::RemoveVisionSource(AActor* Source)
+{
+	if (Source)
+	{
+		CHECK_WORLDS(Source);
+
+		TeamVisionNode->RemoveVisionSource(Source);
+	}
+}
+
+bool ULocusReplicationGraph::SetViewFollowTarget(APlayerController* Follower, APlayerController* Target)
+{
+	ULocusReplicationConnectionGraph* FollowerConnManager = FindLocusConnectionGraph(Follower);
+	ULocusReplicationConnectionGraph* TargetConnManager = FindLocusConnectionGraph(Target);
+	if (!FollowerConnManager || (Target && !TargetConnManager))
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("SetViewFollowTarget: connection of %s not found"), !FollowerConnManager ? *GetNameSafe(Follower) : *GetNameSafe(Target));
+		return false;
+	}
+
+	SetViewFollowTarget(FollowerConnManager, TargetConnManager);
+	return true;
+}
+
+void ULocusReplicationGraph::SetViewFollowTarget(ULocusReplicationConnectionGraph* Follower, ULocusReplicationConnectionGraph* Target)
+{
+	if (!Follower)
+	{
+		return;
+	}
+
+	//follow whoever target follows, so gather never chains
+	for (int32 Depth = 0; Target && Target->GetFollowTarget() && Depth < 8; ++Depth)
+	{
+		Target = Target->GetFollowTarget();
+	}
+
+	if (Target == Follower)
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("SetViewFollowTarget: %s would follow itself"), *GetNameSafe(Follower->NetConnection));
+		Target = nullptr;
+	}
+
+	Follower->FollowTarget = Target;
+}
+
+void ULocusReplicationGraph::SetTeamForPlayerController(APlayerController* PlayerController, FName NextTeam)
+{
+	if (PlayerController)
+	{
+		if (TraceWriter)
+		{
+			TraceWriter->SetTeam(PlayerController, NextTeam);
+		}
+
+		if (ULocusReplicationConnectionGraph* ConnManager = FindLocusConnectionGraph(PlayerController))
+		{
+			FName CurrentTeam = ConnManager->TeamName;
+			if (CurrentTeam != NextTeam)
+			{
+				if (CurrentTeam != NAME_None)
+				{
+					RemoveConnectionFromTeam(CurrentTeam, ConnManager);
+				}
+
+				if (NextTeam != NAME_None)
+				{
+					AddConnectionToTeam(NextTeam, ConnManager);
+				}
+				ConnManager->TeamName = NextTeam;
+			}
+		}
+		else
+		{
+			//only last request matters
+			FPendingOwnerEntry& Entry = PendingOwners.FindOrAdd(PlayerController);
+			if (Entry.PendingSince == 0.0)
+			{
+				Entry.PendingSince = FPlatformTime::Seconds();
+			}
+			Entry.TeamName = NextTeam;
+			Entry.bHasTeamRequest = true;
+		}
+	}
+}
+
+void ULocusReplicationGraph::AddConnectionToTeam(FName TeamName, ULocusReplicationConnectionGraph* ConnManager)
+{
+	UReplicationGraphNode_AlwaysRelevant_TeamShared*& TeamNode = TeamSharedNodes.FindOrAdd(TeamName);
+	if (!TeamNode)
+	{
+		TeamNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_TeamShared>();
+
+		//engine prepares it with other nodes, after pending actors and team requests are handled
+		if (FreeTeamGridNodes.Num() > 0)
+		{
+			TeamNode->TeamGridNode = FreeTeamGridNodes.Pop(false);
+		}
+		else
+		{
+			TeamNode->TeamGridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D_Layered>();
+			InitGridNode(TeamNode->TeamGridNode);
+		}
+	}
+
+	TeamNode->TeamMembers.Add(ConnManager);
+	ConnManager->TeamConnectionNode->AddAllActorsToNode(TeamNode);
+	ConnManager->TeamSpatializedNode->AddAllActorsToGrid(TeamNode->TeamGridNode);
+	ConnManager->TeamSharedNode = TeamNode;
+}
+
+void ULocusReplicationGraph::RemoveConnectionFromTeam(FName TeamName, ULocusReplicationConnectionGraph* ConnManager)
+{
+	if (UReplicationGraphNode_AlwaysRelevant_TeamShared** TeamNodePtr = TeamSharedNodes.Find(TeamName))
+	{
+		UReplicationGraphNode_AlwaysRelevant_TeamShared* TeamNode = *TeamNodePtr;
+		TeamNode->TeamMembers.RemoveSwap(ConnManager);
+		ConnManager->TeamConnectionNode->RemoveAllActorsFromNode(TeamNode);
+		ConnManager->TeamSpatializedNode->RemoveAllActorsFromGrid(TeamNode->TeamGridNode);
+
+		//remove team if there's noone left
+		if (TeamNode->TeamMembers.Num() == 0)
+		{
+			TeamNode->TeamGridNode->NotifyResetAllNetworkActors();
+			FreeTeamGridNodes.Add(TeamNode->TeamGridNode);
+			TeamNode->TeamGridNode = nullptr;
+			TeamSharedNodes.Remove(TeamName);
+		}
+	}
+	ConnManager->TeamSharedNode = nullptr;
+}
+
+void ULocusReplicationGraph::AddActorToConnectionNodes(ULocusReplicationConnectionGraph* ConnManager, EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	switch (Policy)
+	{
+	case EClassRepNodeMapping::RelevantOwnerConnection:
+	{
+		ConnManager->AlwaysRelevantForConnectionNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+	}
+	case EClassRepNodeMapping::RelevantOwnerConnection_Spatialized:
+	{
+		ConnManager->OwnerSpatializedNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+	}
+	case EClassRepNodeMapping::RelevantTeamConnection_Spatialized:
+	{
+		ConnManager->TeamSpatializedNode->NotifyAddNetworkActor(ActorInfo);
+		if (ConnManager->TeamSharedNode)
+		{
+			ConnManager->TeamSharedNode->TeamGridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+		}
+		break;
+	}
+	case EClassRepNodeMapping::RelevantTeamConnection:
+	{
+		ConnManager->TeamConnectionNode->NotifyAddNetworkActor(ActorInfo);
+		if (ConnManager->TeamSharedNode)
+		{
+			ConnManager->TeamSharedNode->NotifyAddNetworkActor(ActorInfo);
+		}
+		break;
+	}
+	};
+}
+
+void ULocusReplicationGraph::RemoveActorFromConnectionNodes(ULocusReplicationConnectionGraph* ConnManager, EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo)
+{
+	switch (Policy)
+	{
+	case EClassRepNodeMapping::RelevantOwnerConnection:
+	{
+		ConnManager->AlwaysRelevantForConnectionNode->NotifyRemoveNetworkActor(ActorInfo);
+		break;
+	}
+	case EClassRepNodeMapping::RelevantOwnerConnection_Spatialized:
+	{
+		ConnManager->OwnerSpatializedNode->NotifyRemoveNetworkActor(ActorInfo);
+		break;
+	}
+	case EClassRepNodeMapping::RelevantTeamConnection_Spatialized:
+	{
+		ConnManager->TeamSpatializedNode->NotifyRemoveNetworkActor(ActorInfo);
+		if (ConnManager->TeamSharedNode)
+		{
+			ConnManager->TeamSharedNode->TeamGridNode->RemoveActor_Dynamic(ActorInfo);
+		}
+		break;
+	}
+	case EClassRepNodeMapping::RelevantTeamConnection:
+	{
+		ConnManager->TeamConnectionNode->NotifyRemoveNetworkActor(ActorInfo);
+		if (ConnManager->TeamSharedNode)
+		{
+			ConnManager->TeamSharedNode->NotifyRemoveNetworkActor(ActorInfo);
+		}
+		break;
+	}
+	};
+}
+
+void ULocusReplicationGraph::RouteAddNetworkActorToConnectionNodes(EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	ULocusReplicationConnectionGraph* ConnManager = FindLocusConnectionGraph(ActorInfo.GetActor());
+	if (!ConnManager && ActorInfo.Actor->GetNetOwner())
+	{
+		//this actor is not yet ready. add to pending entry of it's owner, will be routed when the owner gets connection
+		AddPendingActor(ActorInfo.GetActor());
+		return;
+	}
+
+	if (ConnManager)
+	{
+		AddActorToConnectionNodes(ConnManager, Policy, ActorInfo, GlobalInfo);
+	}
+
+	//unowned actors are tracked without connection, so an owner given later is found like any other owner change
+	FRoutedOwnerActor& Routed = AddRoutedOwnerActor(ActorInfo.GetActor());
+	Routed.Connection = ConnManager;
+	Routed.TopOwner = GetTopNetOwner(ActorInfo.GetActor());
+	Routed.Policy = Policy;
+}
+
+
+void ULocusReplicationGraph::RouteRemoveNetworkActorToConnectionNodes(EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo)
+{
+	//this actor was not yet ready, nothing to remove from nodes
+	if (PendingActorOwners.Num() > 0 && RemovePendingActor(ActorInfo.GetActor()))
+	{
+		return;
+	}
+
+	//remove from connection it was routed to, owner may have changed since
+	FRoutedOwnerActor Routed;
+	if (RoutedOwnerActors.Num() > 0 && RemoveRoutedOwnerActor(ActorInfo.GetActor(), Routed))
+	{
+		ULocusReplicationConnectionGraph* ConnManager = Routed.Connection.Get();
+		if (ConnManager && !ConnManager->bPendingRemoval)
+		{
+			RemoveActorFromConnectionNodes(ConnManager, Routed.Policy, ActorInfo);
+		}
+	}
+}
+
+FRoutedOwnerActor& ULocusReplicationGraph::AddRoutedOwnerActor(AActor* Actor)
+{
+	FRoutedOwnerActor& Routed = RoutedOwnerActors.FindOrAdd(Actor);
+	if (Routed.CheckIndex == INDEX_NONE)
+	{
+		Routed.CheckIndex = OwnerCheckOrder.Add(Actor);
+	}
+	return Routed;
+}
+
+bool ULocusReplicationGraph::RemoveRoutedOwnerActor(AActor* Actor, FRoutedOwnerActor& OutRouted)
+{
+	if (!RoutedOwnerActors.RemoveAndCopyValue(Actor, OutRouted))
+	{
+		return false;
+	}
+
+	const int32 CheckIndex = OutRouted.CheckIndex;
+	OwnerCheckOrder.RemoveAtSwap(CheckIndex, 1, false);
+	if (OwnerCheckOrder.IsValidIndex(CheckIndex))
+	{
+		RoutedOwnerActors.FindChecked(OwnerCheckOrder[CheckIndex]).CheckIndex = CheckIndex;
+	}
+	return true;
+}
+
+void ULocusReplicationGraph::ProcessOwnerChanges()
+{
+	//pending entries are keyed by top owner. an owner that got an owner itself(e.g. pawn possessed) hands it's actors to the new top owner now
+	if (PendingOwners.Num() > 0)
+	{
+		TArray<AActor*> MovedOwners;
+		for (const auto& PendingOwnerPair : PendingOwners)
+		{
+			AActor* Owner = PendingOwnerPair.Key.Get();
+			if (Owner && GetTopNetOwner(Owner) != Owner)
+			{
+				MovedOwners.Add(Owner);
+			}
+		}
+
+		for (AActor* Owner : MovedOwners)
+		{
+			ResolvePendingForOwner(Owner);
+		}
+	}
+
+	TSet<AActor*> ChangedActors;
+	TArray<AActor*> UntrackedActors;
+
+	//walking every owner chain each frame costs more than it finds, spread it over frames
+	const int32 NumChecks = OwnerCheckOrder.Num() > 0 && bTrackOwnerChanges ? (OwnerChangeChecksPerFrame > 0 ? FMath::Min(OwnerChangeChecksPerFrame, OwnerCheckOrder.Num()) : OwnerCheckOrder.Num()) : 0;
+	for (int32 Check = 0; Check < NumChecks; ++Check)
+	{
+		if (NextOwnerCheck >= OwnerCheckOrder.Num())
+		{
+			NextOwnerCheck = 0;
+		}
+
+		AActor* Actor = OwnerCheckOrder[NextOwnerCheck++];
+		if (GetTopNetOwner(Actor) != RoutedOwnerActors.FindChecked(Actor).TopOwner)
+		{
+			ChangedActors.Add(Actor);
+		}
+	}
+
+	//explicit changes carry everything they own
+	if (QueuedOwnerChanges.Num() > 0)
+	{
+		TArray<AActor*> Stack;
+		for (const TWeakObjectPtr<AActor>& ActorPtr : QueuedOwnerChanges)
+		{
+			if (AActor* Actor = ActorPtr.Get())
+			{
+				Stack.Add(Actor);
+			}
+		}
+		QueuedOwnerChanges.Reset();
+
+		TSet<AActor*> Visited;
+		while (Stack.Num() > 0)
+		{
+			AActor* Actor = Stack.Pop(false);
+			bool bAlreadyVisited = false;
+			Visited.Add(Actor, &bAlreadyVisited);
+			if (bAlreadyVisited)
+			{
+				continue;
+			}
+
+			if (RoutedOwnerActors.Contains(Actor))
+			{
+				ChangedActors.Add(Actor);
+			}
+			else if (IsConnectionRelevant(GetMappingPolicy(Actor->GetClass())) && GlobalActorReplicationInfoMap.Find(Actor))
+			{
+				//pending under it's old owner or dropped after expiry
+				UntrackedActors.Add(Actor);
+			}
+			Stack.Append(Actor->Children);
+		}
+	}
+
+	for (AActor* Actor : UntrackedActors)
+	{
+		RemovePendingActor(Actor);
+		RouteAddNetworkActorToConnectionNodes(GetMappingPolicy(Actor->GetClass()), FNewReplicatedActorInfo(Actor), GlobalActorReplicationInfoMap.Get(Actor));
+	}
+
+	if (ChangedActors.Num() == 0)
+	{
+		return;
+	}
+
+	//removal goes to recorded connection, so order inside the batch does not matter. connection is looked up once per top owner
+	TMap<const AActor*, ULocusReplicationConnectionGraph*> ConnectionsByTopOwner;
+	for (AActor* Actor : ChangedActors)
+	{
+		FRoutedOwnerActor& Routed = RoutedOwnerActors.FindChecked(Actor);
+		Routed.TopOwner = GetTopNetOwner(Actor);
+
+		ULocusReplicationConnectionGraph** CachedConnection = ConnectionsByTopOwner.Find(Routed.TopOwner);
+		ULocusReplicationConnectionGraph* NewConnManager = CachedConnection ? *CachedConnection : ConnectionsByTopOwner.Add(Routed.TopOwner, FindLocusConnectionGraph(Actor));
+
+		//owner has no connection yet, pending entry of owner routes it once it does
+		const bool bPending = !NewConnManager && Actor->GetNetOwner();
+		ULocusReplicationConnectionGraph* OldConnManager = Routed.Connection.Get();
+		if (NewConnManager == OldConnManager && !bPending)
+		{
+			continue;
+		}
+
+		const FNewReplicatedActorInfo ActorInfo(Actor);
+		if (OldConnManager && !OldConnManager->bPendingRemoval)
+		{
+			RemoveActorFromConnectionNodes(OldConnManager, Routed.Policy, ActorInfo);
+		}
+
+		if (NewConnManager)
+		{
+			AddActorToConnectionNodes(NewConnManager, Routed.Policy, ActorInfo, GlobalActorReplicationInfoMap.Get(Actor));
+			Routed.Connection = NewConnManager;
+		}
+		else if (bPending)
+		{
+			FRoutedOwnerActor Removed;
+			RemoveRoutedOwnerActor(Actor, Removed);
+			AddPendingActor(Actor);
+		}
+		else
+		{
+			//unowned, stays tracked until it gets an owner
+			Routed.Connection = nullptr;
+		}
+	}
+}
+
+void ULocusReplicationGraph::UpdateAdaptiveReplicationPeriods()
+{
+	if (!bAdaptiveReplicationPeriod)
+	{
+		return;
+	}
+
+	const double CurrentTime = FPlatformTime::Seconds();
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager);
+		if (!LocusConnManager || !ConnManager->NetConnection)
+		{
+			continue;
+		}
+
+		//connection that was not net ready last frame could not send everything it gathered
+		const float Sample = ConnManager->NetConnection->IsNetReady(false) ? 0.f : 1.f;
+		LocusConnManager->SaturationAverage = FMath::Lerp(LocusConnManager->SaturationAverage, Sample, 0.1f);
+
+		if (CurrentTime - LocusConnManager->LastPeriodMultiplierUpdateTime < AdaptivePeriodCooldown)
+		{
+			continue;
+		}
+
+		int32 Multiplier = LocusConnManager->ReplicationPeriodMultiplier;
+		if (LocusConnManager->SaturationAverage > AdaptivePeriodSaturationHigh)
+		{
+			Multiplier = FMath::Min(Multiplier * 2, AdaptivePeriodMaxMultiplier);
+		}
+		else if (LocusConnManager->SaturationAverage < AdaptivePeriodSaturationLow)
+		{
+			Multiplier = FMath::Max(Multiplier / 2, 1);
+		}
+
+		//stretched connections are reapplied each cooldown, actor infos created since then get it too
+		if (Multiplier != LocusConnManager->ReplicationPeriodMultiplier || Multiplier > 1)
+		{
+			LocusConnManager->ReplicationPeriodMultiplier = Multiplier;
+			LocusConnManager->LastPeriodMultiplierUpdateTime = CurrentTime;
+			ApplyReplicationPeriodMultiplier(LocusConnManager);
+		}
+	}
+}
+
+bool ULocusReplicationGraph::IsAdaptivePeriodClass(const UClass* Class) const
+{
+	for (const UClass* PresetClass = Class; PresetClass; PresetClass = PresetClass->GetSuperClass())
+	{
+		const FAdaptivePeriodPreset* Preset = ClassAdaptivePeriods.Find(PresetClass);
+		if (Preset && (PresetClass == Class || Preset->bIncludeChildClasses))
+		{
+			return Preset->bAdaptive;
+		}
+	}
+	return false;
+}
+
+void ULocusReplicationGraph::ApplyReplicationPeriodMultiplier(ULocusReplicationConnectionGraph* ConnManager)
+{
+	for (FActorRepListType Actor : AdaptivePeriodActors)
+	{
+		FConnectionReplicationActorInfo* ConnectionInfo = ConnManager->ActorInfoMap.Find(Actor);
+		const FGlobalActorReplicationInfo* GlobalInfo = ConnectionInfo ? GlobalActorReplicationInfoMap.Find(Actor) : nullptr;
+		if (GlobalInfo)
+		{
+			ConnectionInfo->ReplicationPeriodFrame = FMath::Max<uint32>(GlobalInfo->Settings.ReplicationPeriodFrame, 1) * ConnManager->ReplicationPeriodMultiplier;
+		}
+	}
+}
+
+void ULocusReplicationGraph::RebalanceFrequencyBuckets()
+{
+	if (!bAdaptiveFrequencyBuckets)
+	{
+		return;
+	}
+
+	if (NextFrequencyBucketNode >= FrequencyBucketNodes.Num())
+	{
+		NextFrequencyBucketNode = 0;
+		FrequencyBucketNodes.RemoveAll([](const TWeakObjectPtr<UReplicationGraphNode_LocusFrequencyBuckets>& BucketNode) { return !BucketNode.IsValid(); });
+	}
+
+	typedef UReplicationGraphNode_ActorListFrequencyBuckets::FSettings FBucketSettings;
+	const int32 LastNode = FMath::Min(NextFrequencyBucketNode + FrequencyBucketNodesPerFrame, FrequencyBucketNodes.Num());
+	for (; NextFrequencyBucketNode < LastNode; ++NextFrequencyBucketNode)
+	{
+		UReplicationGraphNode_LocusFrequencyBuckets* BucketNode = FrequencyBucketNodes[NextFrequencyBucketNode].Get();
+		if (!BucketNode)
+		{
+			continue;
+		}
+
+		const int32 DesiredBuckets = FMath::Clamp(FMath::DivideAndRoundUp(BucketNode->NumNonStreamingActors(), FrequencyBucketActorsPerFrame), 1, FrequencyBucketMaxBuckets);
+		const int32 CurrentBuckets = BucketNode->Settings.IsValid() ? BucketNode->Settings->NumBuckets : UReplicationGraphNode_ActorListFrequencyBuckets::DefaultSettings.NumBuckets;
+
+		//grow right away, shrink only when two buckets too many so nodes around a boundary don't flap
+		if (DesiredBuckets > CurrentBuckets || DesiredBuckets < CurrentBuckets - 1)
+		{
+			TSharedPtr<FBucketSettings> Settings = MakeShared<FBucketSettings>(UReplicationGraphNode_ActorListFrequencyBuckets::DefaultSettings);
+			Settings->NumBuckets = DesiredBuckets;
+			Settings->ListSize = FrequencyBucketActorsPerFrame;
+			BucketNode->Settings = Settings;
+			BucketNode->SetNonStreamingCollectionSize(DesiredBuckets);
+		}
+	}
+}
+
+void ULocusReplicationGraph::PrecullConnectionNodes()
+{
+	if (CVarLocusParallelGather.GetValueOnGameThread() == 0)
+	{
+		return;
+	}
+
+	//snapshot viewers the same way the engine does for gather
+	PrecullTasks.Reset();
+	PrecullViewers.Reset();
+	PrecullVisibleLevels.Reset();
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager);
+		UNetConnection* NetConnection = ConnManager->NetConnection;
+		if (!LocusConnManager || !NetConnection || !NetConnection->ViewTarget)
+		{
+			continue;
+		}
+
+		const bool bCullOwner = LocusConnManager->OwnerSpatializedNode->NumOwnedActors() > 0;
+		//team connections gather team grid instead
+		const bool bCullTeam = !LocusConnManager->TeamSharedNode && LocusConnManager->TeamSpatializedNode->NumOwnedActors() > 0;
+		if (!bCullOwner && !bCullTeam)
+		{
+			continue;
+		}
+
+		const int32 ViewerIndex = PrecullViewers.AddDefaulted();
+		FNetViewerArray& Viewers = PrecullViewers[ViewerIndex];
+		Viewers.Emplace(NetConnection, 0.f);
+		for (UNetConnection* ChildConnection : NetConnection->Children)
+		{
+			if (ChildConnection && ChildConnection->ViewTarget)
+			{
+				Viewers.Emplace(ChildConnection, 0.f);
+			}
+		}
+		PrecullVisibleLevels.Add(&NetConnection->ClientVisibleLevelNames);
+
+		if (bCullOwner)
+		{
+			PrecullTasks.Add({ LocusConnManager->OwnerSpatializedNode, ViewerIndex });
+		}
+		if (bCullTeam)
+		{
+			PrecullTasks.Add({ LocusConnManager->TeamSpatializedNode, ViewerIndex });
+		}
+	}
+
+	//each task writes only to it's own node
+	const uint32 Frame = GetReplicationGraphFrame();
+	ParallelFor(PrecullTasks.Num(), [this, Frame](int32 TaskIndex)
+	{
+		const FPrecullTask& Task = PrecullTasks[TaskIndex];
+		Task.Node->PrecullActors(PrecullViewers[Task.ViewerIndex], *PrecullVisibleLevels[Task.ViewerIndex], Frame);
+	}, PrecullTasks.Num() < 2);
+}
+
+void ULocusReplicationGraph::UpdateFollowTargets()
+{
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		if (ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager))
+		{
+			LocusConnManager->NumFollowers = 0;
+		}
+	}
+
+	bool bFollowerBeforeTarget = false;
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager);
+		ULocusReplicationConnectionGraph* Target = LocusConnManager ? LocusConnManager->GetFollowTarget() : nullptr;
+		if (!Target)
+		{
+			continue;
+		}
+
+		//target started following another connection, follow that one so targets never skip their own gathers
+		if (Target->GetFollowTarget())
+		{
+			SetViewFollowTarget(LocusConnManager, Target);
+			Target = LocusConnManager->GetFollowTarget();
+			if (!Target)
+			{
+				continue;
+			}
+		}
+
+		++Target->NumFollowers;
+		bFollowerBeforeTarget |= Target->ConnectionOrderNum > LocusConnManager->ConnectionOrderNum;
+	}
+
+	//engine gathers connections in order, targets must record their lists before followers gather
+	if (bFollowerBeforeTarget)
+	{
+		Connections.StableSort([](const UNetReplicationGraphConnection& A, const UNetReplicationGraphConnection& B)
+		{
+			const ULocusReplicationConnectionGraph* LocusA = Cast<ULocusReplicationConnectionGraph>(&A);
+			const ULocusReplicationConnectionGraph* LocusB = Cast<ULocusReplicationConnectionGraph>(&B);
+			return !(LocusA && LocusA->GetFollowTarget()) && (LocusB && LocusB->GetFollowTarget());
+		});
+
+		bConnectionListsDirty = true;
+		CompactConnectionLists();
+	}
+}
+
+void ULocusReplicationGraph::HandlePendingActorsAndTeamRequests()
+{
+	SCOPE_CYCLE_COUNTER(STAT_LocusRepGraph_HandlePending);
+	CSV_SCOPED_TIMING_STAT(LocusRepGraph, HandlePending);
+	FLocusScopedStatCycles ScopedCycles(Stats.PendingCycles);
+
+	//only connections whose PlayerController has changed since last check can resolve pending entries
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager);
+		APlayerController* PlayerController = ConnManager->NetConnection ? ConnManager->NetConnection->PlayerController : nullptr;
+		if (LocusConnManager && PlayerController && LocusConnManager->CachedPlayerController.Get() != PlayerController)
+		{
+			UpdateConnectionPlayerController(LocusConnManager, PlayerController);
+		}
+	}
+
+	if (PendingOwners.Num() == 0)
 	{
-		RouteRemoveNetworkActorToConnectionNodes(Policy, ActorInfo);
-		break;
+		return;
 	}
 
-	case EClassRepNodeMapping::Spatialize_Static:
+	const double CurrentTime = FPlatformTime::Seconds();
+	if (CurrentTime >= NextPendingSweepTime)
 	{
-		GridNode->RemoveActor_Static(ActorInfo);
-		break;
+		NextPendingSweepTime = CurrentTime + 1.0;
+		SweepPendingOwners();
 	}
+}
 
-	case EClassRepNodeMapping::Spatialize_Dynamic:
+void ULocusReplicationGraph::UpdateConnectionPlayerController(ULocusReplicationConnectionGraph* ConnManager, APlayerController* PlayerController)
+{
+	ConnectionsByPlayerController.Remove(ConnManager->CachedPlayerController);
+	ConnManager->CachedPlayerController = PlayerController;
+	ConnectionsByPlayerController.Add(PlayerController, ConnManager);
+
+	if (TraceWriter)
 	{
-		GridNode->RemoveActor_Dynamic(ActorInfo);
-		break;
+		TraceWriter->SetConnectionPlayerController(ConnManager, PlayerController);
 	}
 
-	case EClassRepNodeMapping::Spatialize_Dormancy:
+	if (PendingOwners.Num() > 0)
 	{
-		GridNode->RemoveActor_Dormancy(ActorInfo);
-		break;
+		ResolvePendingForOwner(PlayerController);
 	}
-	};
 }
 
-//this function will be called seamless map transition
-//as all actors will be removed in silly order, we have to deal with it
-void ULocusReplicationGraph::ResetGameWorldState()
+void ULocusReplicationGraph::ResolvePendingForOwner(AActor* Owner)
 {
-	Super::ResetGameWorldState();
+	FPendingOwnerEntry Entry;
+	if (!PendingOwners.RemoveAndCopyValue(Owner, Entry))
+	{
+		return;
+	}
 
-	//all actor will be destroyed. just reset it.
-	PendingConnectionActors.Reset();
-	PendingTeamRequests.Reset();
-	#pragma warning(push)
-	#pragma warning(disable: 4458)
-	auto EmptyConnectionNode = [](TArray<UNetReplicationGraphConnection*>& Connections)
+	if (Entry.bHasTeamRequest)
 	{
-		for (UNetReplicationGraphConnection* ConnManager : Connections)
+		//if failed, it will automatically re-added to pending entry
+		SetTeamForPlayerController(Cast<APlayerController>(Owner), Entry.TeamName);
+	}
+
+	for (const TWeakObjectPtr<AActor>& ActorPtr : Entry.Actors)
+	{
+		PendingActorOwners.Remove(ActorPtr);
+		if (AActor* Actor = ActorPtr.Get())
 		{
-			if (ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager))
+			//if failed, it will automatically re-added to pending entry
+			EClassRepNodeMapping Policy = GetMappingPolicy(Actor->GetClass());
+			FGlobalActorReplicationInfo& GlobalInfo = GlobalActorReplicationInfoMap.Get(Actor);
+			RouteAddNetworkActorToConnectionNodes(Policy, FNewReplicatedActorInfo(Actor), GlobalInfo);
+		}
+	}
+
+	//actors still pending keep their original time, so they expire eventually
+	for (const TWeakObjectPtr<AActor>& ActorPtr : Entry.Actors)
+	{
+		if (TWeakObjectPtr<AActor>* NewOwner = PendingActorOwners.Find(ActorPtr))
+		{
+			if (FPendingOwnerEntry* NewEntry = PendingOwners.Find(*NewOwner))
 			{
-				LocusConnManager->AlwaysRelevantForConnectionNode->NotifyResetAllNetworkActors();
+				NewEntry->PendingSince = FMath::Min(NewEntry->PendingSince, Entry.PendingSince);
 			}
 		}
-	};
-	#pragma warning(pop)
-	EmptyConnectionNode(PendingConnections);
-	EmptyConnectionNode(Connections);
+	}
+}
 
-	//as connection does not destroyed, we keep it
-	//TeamConnectionListMap.Reset();
+void ULocusReplicationGraph::AddPendingActor(AActor* Actor)
+{
+	AActor* Owner = GetTopNetOwner(Actor);
+	FPendingOwnerEntry& Entry = PendingOwners.FindOrAdd(Owner);
+	if (Entry.PendingSince == 0.0)
+	{
+		Entry.PendingSince = FPlatformTime::Seconds();
+	}
+	Entry.Actors.Add(Actor);
+	PendingActorOwners.Add(Actor, Owner);
 }
 
-// Since we listen to global (static) events, we need to watch out for cross world broadcasts (PIE)
-#if WITH_EDITOR
-#define CHECK_WORLDS(X) if(X->GetWorld() != GetWorld()) return;
-#else
-#define CHECK_WORLDS(X)
-#endif
+bool ULocusReplicationGraph::RemovePendingActor(AActor* Actor)
+{
+	TWeakObjectPtr<AActor> Owner;
+	if (!PendingActorOwners.RemoveAndCopyValue(Actor, Owner))
+	{
+		return false;
+	}
 
-void ULocusReplicationGraph::AddDependentActor(AActor* ReplicatorActor, AActor* DependentActor)
+	if (FPendingOwnerEntry* Entry = PendingOwners.Find(Owner))
+	{
+		Entry->Actors.Remove(Actor);
+		if (Entry->Actors.Num() == 0 && !Entry->bHasTeamRequest)
+		{
+			PendingOwners.Remove(Owner);
+		}
+	}
+	return true;
+}
+
+void ULocusReplicationGraph::SweepPendingOwners()
 {
-	if (ReplicatorActor && DependentActor)
+	const double ExpireTime = PendingActorExpireTime > 0.f ? FPlatformTime::Seconds() - PendingActorExpireTime : 0.0;
+	TArray<AActor*> OwnersToResolve;
+	int32 NumExpired = 0;
+
+	for (auto It = PendingOwners.CreateIterator(); It; ++It)
 	{
-		CHECK_WORLDS(ReplicatorActor);
+		AActor* Owner = It.Key().Get();
+		if (!Owner || It.Value().PendingSince < ExpireTime)
+		{
+			NumExpired += It.Value().Actors.Num();
+			for (const TWeakObjectPtr<AActor>& ActorPtr : It.Value().Actors)
+			{
+				PendingActorOwners.Remove(ActorPtr);
+			}
+			It.RemoveCurrent();
+		}
+		else if (!Owner->IsA<APlayerController>() || Owner->GetNetConnection())
+		{
+			//owner may have got a connection without it's owner chain changing, try routing again
+			OwnersToResolve.Add(Owner);
+		}
+	}
+
+	for (AActor* Owner : OwnersToResolve)
+	{
+		ResolvePendingForOwner(Owner);
+	}
+
+	if (NumExpired > 0)
+	{
+		UE_LOG(LogLocusReplicationGraph, Verbose, TEXT("Dropped %d expired pending actors"), NumExpired);
+	}
+}
 
-		if (FGlobalActorReplicationInfo* ReplicationInfo = GlobalActorReplicationInfoMap.Find(ReplicatorActor))
+class ULocusReplicationConnectionGraph* ULocusReplicationGraph::FindLocusConnectionGraph(const AActor* Actor)
+{
+	if (Actor)
+	{
+		//PlayerController is a direct hash probe
+		if (const APlayerController* PlayerController = Cast<APlayerController>(Actor))
 		{
-			if (!ReplicationInfo->GetDependentActorList().Contains(DependentActor))
+			if (ULocusReplicationConnectionGraph* ConnManager = ConnectionsByPlayerController.FindRef(const_cast<APlayerController*>(PlayerController)))
 			{
-				GlobalActorReplicationInfoMap.AddDependentActor(ReplicatorActor,DependentActor);
+				return ConnManager;
 			}
 		}
-		else
+
+		if (UNetConnection* NetConnection = Actor->GetNetConnection())
 		{
-			UE_LOG(LogLocusReplicationGraph, Warning, TEXT("ReplicatorActor privided is not replicating"));
+			if (ULocusReplicationConnectionGraph* ConnManager = ConnectionSlots.Find(NetConnection))
+			{
+				return ConnManager;
+			}
+
+			//splitscreen child connection shares parent's connection graph
+			if (UChildConnection* ChildConnection = Cast<UChildConnection>(NetConnection))
+			{
+				return ConnectionSlots.Find(ChildConnection->Parent);
+			}
 		}
 	}
+	return nullptr;
 }
 
-void ULocusReplicationGraph::RemoveDependentActor(AActor* ReplicatorActor, AActor* DependentActor)
+#if WITH_GAMEPLAY_DEBUGGER
+void ULocusReplicationGraph::OnGameplayDebuggerOwnerChange(AGameplayDebuggerCategoryReplicator* Debugger, APlayerController* OldOwner)
 {
-	if (ReplicatorActor && DependentActor)
+	//removes from recorded connection
+	FNewReplicatedActorInfo ActorInfo(Debugger);
+	RouteRemoveNetworkActorToConnectionNodes(EClassRepNodeMapping::RelevantOwnerConnection, ActorInfo);
+
+	if (ULocusReplicationConnectionGraph* ConnManager = FindLocusConnectionGraph(Debugger->GetReplicationOwner()))
 	{
-		CHECK_WORLDS(ReplicatorActor);
+		AddActorToConnectionNodes(ConnManager, EClassRepNodeMapping::RelevantOwnerConnection, ActorInfo, GlobalActorReplicationInfoMap.Get(Debugger));
+
+		FRoutedOwnerActor& Routed = AddRoutedOwnerActor(Debugger);
+		Routed.Connection = ConnManager;
+		Routed.TopOwner = GetTopNetOwner(Debugger);
+		Routed.Policy = EClassRepNodeMapping::RelevantOwnerConnection;
+	}
+}
+#endif
+
+void ULocusReplicationGraph::PrintRepNodePolicies()
+{
+	UEnum* Enum = FindObject<UEnum>(ANY_PACKAGE, TEXT("EClassRepNodeMapping"));
+	if (!Enum)
+	{
+		return;
+	}
+
+	GLog->Logf(TEXT("===================================="));
+	GLog->Logf(TEXT("Shooter Replication Routing Policies"));
+	GLog->Logf(TEXT("===================================="));
+
+	for (auto It = ClassRepNodePolicies.CreateIterator(); It; ++It)
+	{
+		FObjectKey ObjKey = It.Key();
+
+		EClassRepNodeMapping Mapping = It.Value();
+
+		GLog->Logf(TEXT("%-40s --> %s"), *GetNameSafe(ObjKey.ResolveObjectPtr()), *Enum->GetNameStringByValue(static_cast<uint32>(Mapping)));
+	}
+}
+
+EClassRepNodeMapping ULocusReplicationGraph::GetMappingPolicy(UClass* Class)
+{
+	if (const EClassRepNodeMapping* CachedPolicy = ClassPolicyTable.Find(Class))
+	{
+		ClassPolicyTable.NumHits++;
+		return *CachedPolicy;
+	}
+
+	ClassPolicyTable.NumMisses++;
+	EClassRepNodeMapping* PolicyPtr = ClassRepNodePolicies.Get(Class);
+	EClassRepNodeMapping Policy = PolicyPtr ? *PolicyPtr : EClassRepNodeMapping::NotRouted;
+	ClassPolicyTable.Set(Class, Policy);
+	return Policy;
+}
+
+void ULocusReplicationGraph::OnPostGarbageCollect()
+{
+	ClassPolicyTable.PurgeStale();
+}
 
-		if (FGlobalActorReplicationInfo* ReplicationInfo = GlobalActorReplicationInfoMap.Find(ReplicatorActor))
+void ULocusReplicationGraph::PrintPolicyCacheStats()
+{
+	const uint64 NumLookups = ClassPolicyTable.NumHits + ClassPolicyTable.NumMisses;
+	GLog->Logf(TEXT("%s : %d classes cached, %llu hits, %llu misses (%.2f%% hit rate)"), *GetName(), ClassPolicyTable.Num(), ClassPolicyTable.NumHits, ClassPolicyTable.NumMisses,
+		NumLookups > 0 ? 100.0 * ClassPolicyTable.NumHits / NumLookups : 0.0);
+}
+
+void ULocusReplicationGraph::PrintAdaptiveReplicationPeriods()
+{
+	GLog->Logf(TEXT("%s : adaptive replication period %s"), *GetName(), bAdaptiveReplicationPeriod ? TEXT("on") : TEXT("off"));
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		if (ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager))
 		{
-			GlobalActorReplicationInfoMap.RemoveDependentActor(ReplicatorActor,DependentActor);
+			GLog->Logf(TEXT("  %s : saturation %.2f, queued bits %d, period x%d"), *GetNameSafe(ConnManager->NetConnection), LocusConnManager->SaturationAverage,
+				ConnManager->NetConnection ? ConnManager->NetConnection->QueuedBits : 0, LocusConnManager->ReplicationPeriodMultiplier);
 		}
-		else
+	}
+}
+
+void ULocusReplicationGraph::SampleStats()
+{
+	Stats.EndFrame();
+	Stats.PendingActors.Add(PendingActorOwners.Num());
+	Stats.PendingOwners.Add(PendingOwners.Num());
+
+	int32 MaxTeamSize = 0;
+	for (const auto& TeamNodePair : TeamSharedNodes)
+	{
+		MaxTeamSize = FMath::Max(MaxTeamSize, TeamNodePair.Value->TeamMembers.Num());
+	}
+	Stats.Teams.Add(TeamSharedNodes.Num());
+	Stats.MaxTeamSize.Add(MaxTeamSize);
+
+	int32 TotalConnectionActors = 0;
+	int32 MaxConnectionActors = 0;
+	float MaxConnectionGatherMs = 0.f;
+	int32 NumConnections = 0;
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager);
+		if (LocusConnManager)
 		{
-			UE_LOG(LogLocusReplicationGraph, Warning, TEXT("ReplicatorActor privided is not replicating"));
+			LocusConnManager->GatheredActorsHistory.Add(LocusConnManager->GatheredActors);
+			TotalConnectionActors += LocusConnManager->GatheredActors;
+			MaxConnectionActors = FMath::Max(MaxConnectionActors, LocusConnManager->GatheredActors);
+			LocusConnManager->GatheredActors = 0;
+
+			const float GatherMs = FPlatformTime::ToMilliseconds64(LocusConnManager->GatherCycles);
+			LocusConnManager->GatherMsHistory.Add(GatherMs);
+			MaxConnectionGatherMs = FMath::Max(MaxConnectionGatherMs, GatherMs);
+			LocusConnManager->GatherCycles = 0;
+			++NumConnections;
 		}
 	}
+	const float AverageConnectionActors = NumConnections > 0 ? (float)TotalConnectionActors / NumConnections : 0.f;
+	Stats.ConnectionActors.Add(AverageConnectionActors);
+	Stats.MaxConnectionGatherMs.Add(MaxConnectionGatherMs);
+
+	typedef UReplicationGraphNode_GridSpatialization2D_Layered::EGridPath EGridPath;
+	Stats.GridStaticActors.Add(GridNode->NumActors(EGridPath::Static));
+	Stats.GridDynamicActors.Add(GridNode->NumActors(EGridPath::Dynamic));
+	Stats.GridDormancyActors.Add(GridNode->NumActors(EGridPath::Dormancy));
+	Stats.GridPathChanges.Add(GridNode->NumAutoPathChanges);
+
+	SET_DWORD_STAT(STAT_LocusRepGraph_PendingActors, PendingActorOwners.Num());
+	SET_DWORD_STAT(STAT_LocusRepGraph_PendingOwners, PendingOwners.Num());
+	SET_DWORD_STAT(STAT_LocusRepGraph_Teams, TeamSharedNodes.Num());
+	SET_DWORD_STAT(STAT_LocusRepGraph_MaxTeamSize, MaxTeamSize);
+	SET_DWORD_STAT(STAT_LocusRepGraph_MaxConnectionActors, MaxConnectionActors);
+	SET_FLOAT_STAT(STAT_LocusRepGraph_MaxConnectionGatherMs, MaxConnectionGatherMs);
+
+	CSV_CUSTOM_STAT(LocusRepGraph, PendingActors, PendingActorOwners.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(LocusRepGraph, PendingOwners, PendingOwners.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(LocusRepGraph, Teams, TeamSharedNodes.Num(), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(LocusRepGraph, MaxTeamSize, MaxTeamSize, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(LocusRepGraph, AvgConnectionActors, AverageConnectionActors, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(LocusRepGraph, MaxConnectionActors, MaxConnectionActors, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(LocusRepGraph, MaxConnectionGatherMs, MaxConnectionGatherMs, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(LocusRepGraph, GridStaticActors, GridNode->NumActors(EGridPath::Static), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(LocusRepGraph, GridDynamicActors, GridNode->NumActors(EGridPath::Dynamic), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(LocusRepGraph, GridDormancyActors, GridNode->NumActors(EGridPath::Dormancy), ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(LocusRepGraph, GridPathChanges, GridNode->NumAutoPathChanges, ECsvCustomStatOp::Set);
 }
 
-void ULocusReplicationGraph::ChangeOwnerOfAnActor(AActor* ActorToChange, AActor* NewOwner)
+void ULocusReplicationGraph::PrintStats()
 {
-	EClassRepNodeMapping Policy = GetMappingPolicy(ActorToChange->GetClass());
-	if (!ActorToChange || Policy == EClassRepNodeMapping::NotRouted || IsSpatialized(Policy))
+	GLog->Logf(TEXT("%s : rolling stats per frame"), *GetName());
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Route add ms"), Stats.RouteAddMs);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Route adds"), Stats.RouteAdds);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Route remove ms"), Stats.RouteRemoveMs);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Route removes"), Stats.RouteRemoves);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Pending handler ms"), Stats.PendingMs);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Pending actors"), Stats.PendingActors);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Pending owners"), Stats.PendingOwners);
+	for (int32 StatIndex = 0; StatIndex < (int32)ELocusGatherStat::Num; ++StatIndex)
 	{
-		//Policy doesn't matter for chaning owner
-		return;
+		FLocusReplicationGraphStats::PrintBuffer(*FString::Printf(TEXT("%s gather ms"), LexToString((ELocusGatherStat)StatIndex)), Stats.GatherMs[StatIndex]);
 	}
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Teams"), Stats.Teams);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Max team size"), Stats.MaxTeamSize);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Avg connection actors"), Stats.ConnectionActors);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Max connection gather ms"), Stats.MaxConnectionGatherMs);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Grid static actors"), Stats.GridStaticActors);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Grid dynamic actors"), Stats.GridDynamicActors);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Grid dormancy actors"), Stats.GridDormancyActors);
+	FLocusReplicationGraphStats::PrintBuffer(TEXT("Grid path changes"), Stats.GridPathChanges);
+
+	GLog->Logf(TEXT("%s : owner/team/follow actors gathered and gather ms per connection"), *GetName());
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		if (ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager))
+		{
+			const FString ConnectionName = FString::Printf(TEXT("%s(%s)"), *GetNameSafe(ConnManager->NetConnection), *LocusConnManager->TeamName.ToString());
+			FLocusReplicationGraphStats::PrintBuffer(*ConnectionName, LocusConnManager->GatheredActorsHistory);
+			FLocusReplicationGraphStats::PrintBuffer(*FString::Printf(TEXT("%s gather ms"), *ConnectionName), LocusConnManager->GatherMsHistory);
+		}
+	}
+}
+
+void ULocusReplicationGraph::ResetStats()
+{
+	Stats.Reset();
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		if (ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager))
+		{
+			LocusConnManager->GatheredActorsHistory.Reset();
+			LocusConnManager->GatherMsHistory.Reset();
+		}
+	}
+}
 
-	//remove from previous connection specific nodes.
-	RouteRemoveNetworkActorToConnectionNodes(Policy, FNewReplicatedActorInfo(ActorToChange));
+bool ULocusReplicationGraph::StartTrace(const FString& Filename)
+{
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("StartTrace: graph has no world"));
+		return false;
+	}
 
-	//change owner safely
-	ActorToChange->SetOwner(NewOwner);
+	StopTrace();
 
-	//re-route to connection specific nodes with new owner
-	FGlobalActorReplicationInfo& GlobalInfo = GlobalActorReplicationInfoMap.Get(ActorToChange);
-	RouteAddNetworkActorToConnectionNodes(Policy, FNewReplicatedActorInfo(ActorToChange), GlobalInfo);
+	FString TraceFilename = Filename;
+	if (TraceFilename.IsEmpty())
+	{
+		TraceFilename = FPaths::ProjectSavedDir() / TEXT("LocusTraces") / FString::Printf(TEXT("%s_%s.lrtrace"), *UWorld::RemovePIEPrefix(World->GetMapName()), *FDateTime::Now().ToString());
+	}
+
+	TraceWriter = FLocusTraceWriter::Create(TraceFilename, GetClass()->GetPathName(), ComputeSpatialBounds(World));
+	if (!TraceWriter)
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("StartTrace: could not create %s"), *TraceFilename);
+		return false;
+	}
+
+	WriteTraceSnapshot();
+	UE_LOG(LogLocusReplicationGraph, Log, TEXT("Tracing replication graph inputs to %s"), *TraceFilename);
+	return true;
 }
 
-void ULocusReplicationGraph::SetTeamForPlayerController(APlayerController* PlayerController, FName NextTeam)
+void ULocusReplicationGraph::StopTrace()
 {
-	if (PlayerController)
+	if (TraceWriter)
 	{
-		if (ULocusReplicationConnectionGraph* ConnManager = FindLocusConnectionGraph(PlayerController))
+		UE_LOG(LogLocusReplicationGraph, Log, TEXT("Stopped trace %s, %d frames, %lld bytes"), *TraceWriter->GetFilename(), TraceWriter->GetNumFrames(), TraceWriter->GetTotalBytes());
+		TraceWriter.Reset();
+	}
+}
+
+void ULocusReplicationGraph::WriteTraceSnapshot()
+{
+	//connections first, so owner and team records of actors can be resolved on replay
+	auto WriteConnections = [this](const TArray<UNetReplicationGraphConnection*>& ConnectionList)
+	{
+		for (UNetReplicationGraphConnection* ConnManager : ConnectionList)
 		{
-			FName CurrentTeam = ConnManager->TeamName;
-			if (CurrentTeam != NextTeam)
+			ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager);
+			if (!LocusConnManager)
 			{
-				if (CurrentTeam != NAME_None)
-				{
-					TeamConnectionListMap.RemoveConnectionFromTeam(CurrentTeam, ConnManager);
-				}
+				continue;
+			}
 
-				if (NextTeam != NAME_None)
+			TraceWriter->AddConnection(LocusConnManager);
+			if (APlayerController* PlayerController = LocusConnManager->CachedPlayerController.Get())
+			{
+				TraceWriter->SetConnectionPlayerController(LocusConnManager, PlayerController);
+				if (LocusConnManager->TeamName != NAME_None)
 				{
-					TeamConnectionListMap.AddConnectionToTeam(NextTeam, ConnManager);
+					TraceWriter->SetTeam(PlayerController, LocusConnManager->TeamName);
 				}
-				ConnManager->TeamName = NextTeam;
 			}
 		}
-		else
+	};
+	WriteConnections(Connections);
+	WriteConnections(PendingConnections);
+
+	TArray<AActor*> RoutedActors;
+	for (const TSharedPtr<FNetworkObjectInfo>& ObjectInfo : NetDriver->GetNetworkObjectList().GetAllObjects())
+	{
+		AActor* Actor = ObjectInfo.IsValid() ? ObjectInfo->Actor : nullptr;
+		if (Actor && !Actor->IsPendingKill())
+		{
+			TraceWriter->AddActor(Actor, Actor->GetOwner());
+			RoutedActors.Add(Actor);
+		}
+	}
+
+	TArray<AActor*> Dependents;
+	for (AActor* Actor : RoutedActors)
+	{
+		Dependents.Reset();
+		GetDependentActors(Actor, Dependents, false);
+		for (AActor* Dependent : Dependents)
 		{
-			PendingTeamRequests.Emplace(NextTeam, PlayerController);
+			TraceWriter->SetDependentActor(Actor, Dependent, true);
 		}
 	}
 }
 
-void ULocusReplicationGraph::RouteAddNetworkActorToConnectionNodes(EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+void ULocusReplicationGraph::RecordTraceFrame()
+{
+	if (!TraceWriter)
+	{
+		return;
+	}
+
+	for (UNetReplicationGraphConnection* ConnManager : Connections)
+	{
+		ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(ConnManager);
+		UNetConnection* NetConnection = ConnManager->NetConnection;
+		if (LocusConnManager && NetConnection && NetConnection->ViewTarget)
+		{
+			const FNetViewer Viewer(NetConnection, 0.f);
+			TraceWriter->ViewerLocation(LocusConnManager, Viewer.ViewLocation);
+		}
+	}
+
+	TraceWriter->UpdateActorLocations(CVarLocusTraceMoveThreshold.GetValueOnGameThread());
+
+	UWorld* World = GetWorld();
+	TraceWriter->MarkFrame(GetReplicationGraphFrame(), World ? World->GetDeltaSeconds() : 0.f);
+}
+
+void UReplicationGraphNode_AlwaysRelevant_ForTeam::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
 {
-	if (ULocusReplicationConnectionGraph* ConnManager = FindLocusConnectionGraph(ActorInfo.GetActor()))
+	SCOPE_CYCLE_COUNTER(STAT_LocusRepGraph_TeamGather);
+	CSV_SCOPED_TIMING_STAT(LocusRepGraph, TeamGather);
+	LOCUS_SCOPE_GATHER_STAT(Team, Params);
+	const FLocusScopedFollowGather FollowGather(Params, false);
+
+	ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(&Params.ConnectionManager);
+	if (LocusConnManager && LocusConnManager->TeamSharedNode)
+	{
+		//team node already contains this connection's actors as well as teammates'
+		LocusConnManager->TeamSharedNode->GatherActorListsForConnection(Params);
+		LocusConnManager->GatheredActors += LocusConnManager->TeamSharedNode->NumActors();
+	}
+	else
 	{
-		switch (Policy)
+		Super::GatherActorListsForConnection(Params);
+		if (LocusConnManager)
 		{
-		case EClassRepNodeMapping::RelevantOwnerConnection:
+			LocusConnManager->GatheredActors += ReplicationActorList.Num();
+		}
+	}
+}
+
+void UReplicationGraphNode_AlwaysRelevant_ForTeam::AddAllActorsToNode(UReplicationGraphNode_ActorList* TargetNode)
+{
+	//walk own lists directly, target keeps streaming actors in their level list like this node
+	for (FActorRepListType Actor : ReplicationActorList)
+	{
+		TargetNode->NotifyAddNetworkActor(FNewReplicatedActorInfo(Actor));
+	}
+	for (const FStreamingLevelActorListCollection::FStreamingLevelActors& LevelActors : StreamingLevelCollection.StreamingLevelLists)
+	{
+		for (FActorRepListType Actor : LevelActors.ReplicationActorList)
 		{
-			ConnManager->AlwaysRelevantForConnectionNode->NotifyAddNetworkActor(ActorInfo);
-			break;
+			TargetNode->NotifyAddNetworkActor(FNewReplicatedActorInfo(Actor));
 		}
-		case EClassRepNodeMapping::RelevantTeamConnection:
+	}
+}
+
+void UReplicationGraphNode_AlwaysRelevant_ForTeam::RemoveAllActorsFromNode(UReplicationGraphNode_ActorList* TargetNode)
+{
+	for (FActorRepListType Actor : ReplicationActorList)
+	{
+		TargetNode->NotifyRemoveNetworkActor(FNewReplicatedActorInfo(Actor));
+	}
+	for (const FStreamingLevelActorListCollection::FStreamingLevelActors& LevelActors : StreamingLevelCollection.StreamingLevelLists)
+	{
+		for (FActorRepListType Actor : LevelActors.ReplicationActorList)
 		{
-			ConnManager->TeamConnectionNode->NotifyAddNetworkActor(ActorInfo);
-			break;
+			TargetNode->NotifyRemoveNetworkActor(FNewReplicatedActorInfo(Actor));
 		}
-		};
 	}
-	else if(ActorInfo.Actor->GetNetOwner())
+}
+
+void UReplicationGraphNode_OwnerSpatialized::NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo)
+{
+	FOwnedActor& OwnedActor = OwnedActors.AddDefaulted_GetRef();
+	OwnedActor.Actor = ActorInfo.Actor;
+	OwnedActor.StreamingLevelName = ActorInfo.StreamingLevelName;
+	OwnedActor.GlobalInfo = &GraphGlobals->GlobalActorReplicationInfoMap->Get(ActorInfo.Actor);
+	bHasPrecull = false;
+}
+
+bool UReplicationGraphNode_OwnerSpatialized::NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound)
+{
+	const int32 Index = OwnedActors.IndexOfByPredicate([&](const FOwnedActor& OwnedActor) { return OwnedActor.Actor == ActorInfo.Actor; });
+	if (Index == INDEX_NONE)
+	{
+		UE_CLOG(bWarnIfNotFound, LogLocusReplicationGraph, Warning, TEXT("Attempted to remove %s from OwnerSpatialized node %s but it was not found."), *GetActorRepListTypeDebugString(ActorInfo.Actor), *GetName());
+		return false;
+	}
+
+	OwnedActors.RemoveAtSwap(Index, 1, false);
+	bHasPrecull = false;
+	return true;
+}
+
+void UReplicationGraphNode_OwnerSpatialized::NotifyResetAllNetworkActors()
+{
+	OwnedActors.Reset();
+	CulledActors.Reset();
+	bHasPrecull = false;
+	bCulledListBuilt = false;
+	if (CulledList.IsValid())
 	{
-		//this actor is not yet ready. add to pending array to handle pending route
-		PendingConnectionActors.Add(ActorInfo.GetActor());
+		CulledList.Reset();
 	}
 }
 
-
-void ULocusReplicationGraph::RouteRemoveNetworkActorToConnectionNodes(EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo)
+void UReplicationGraphNode_OwnerSpatialized::CullActors(const FNetViewerArray& Viewers, TFunctionRef<bool(FName)> IsLevelVisible, TArray<FActorRepListType>& OutActors) const
 {
-	if (ULocusReplicationConnectionGraph* ConnManager = FindLocusConnectionGraph(ActorInfo.GetActor()))
+	for (const FOwnedActor& OwnedActor : OwnedActors)
 	{
-		switch (Policy)
+		if (OwnedActor.StreamingLevelName != NAME_None && !IsLevelVisible(OwnedActor.StreamingLevelName))
 		{
-		case EClassRepNodeMapping::RelevantOwnerConnection:
+			continue;
+		}
+
+		const float CullDistanceSquared = OwnedActor.GlobalInfo->Settings.GetCullDistanceSquared();
+		if (CullDistanceSquared <= 0.f)
 		{
-			ConnManager->AlwaysRelevantForConnectionNode->NotifyRemoveNetworkActor(ActorInfo);
-			break;
+			OutActors.Add(OwnedActor.Actor);
+			continue;
 		}
-		case EClassRepNodeMapping::RelevantTeamConnection:
+
+		const FVector Location = OwnedActor.Actor->GetActorLocation();
+		for (const FNetViewer& Viewer : Viewers)
 		{
-			ConnManager->TeamConnectionNode->NotifyRemoveNetworkActor(ActorInfo);
-			break;
+			if (FVector::DistSquared(Location, Viewer.ViewLocation) <= CullDistanceSquared)
+			{
+				OutActors.Add(OwnedActor.Actor);
+				break;
+			}
 		}
-		};
-	}
-	else if (ActorInfo.Actor->GetNetOwner())
-	{
-		//this actor is not yet ready. but doesn't matter the pending array contains the actor or not
-		PendingConnectionActors.Remove(ActorInfo.GetActor());
 	}
 }
 
-void ULocusReplicationGraph::HandlePendingActorsAndTeamRequests()
+void UReplicationGraphNode_OwnerSpatialized::PrecullActors(const FNetViewerArray& Viewers, const TSet<FName>& VisibleLevels, uint32 Frame)
+{
+	CulledActors.Reset();
+	CullActors(Viewers, [&](FName LevelName) { return VisibleLevels.Contains(LevelName); }, CulledActors);
+	PrecullFrame = Frame;
+	bHasPrecull = true;
+	bCulledListBuilt = false;
+}
+
+void UReplicationGraphNode_OwnerSpatialized::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
 {
-	if(PendingTeamRequests.Num() > 0)
+	LOCUS_SCOPE_GATHER_STAT(Owner, Params);
+
+	if (OwnedActors.Num() == 0)
+	{
+		bHasPrecull = false;
+		return;
+	}
+
+	auto IsLevelVisible = [&](FName LevelName) { return Params.CheckClientVisibilityForLevel(LevelName); };
+	const uint32 Frame = GraphGlobals->ReplicationGraph->GetReplicationGraphFrame();
+	if (!bHasPrecull || PrecullFrame != Frame)
 	{
-		TArray<FTeamRequest> TempRequests = MoveTemp(PendingTeamRequests);
+		CulledActors.Reset();
+		CullActors(Params.Viewers, IsLevelVisible, CulledActors);
 
-		for (FTeamRequest& Request : TempRequests)
+		PrecullFrame = Frame;
+		bHasPrecull = true;
+		bCulledListBuilt = false;
+	}
+	else if (!bCulledListBuilt && CVarLocusVerifyParallelGather.GetValueOnGameThread() != 0)
+	{
+		TArray<FActorRepListType> SerialActors;
+		CullActors(Params.Viewers, IsLevelVisible, SerialActors);
+		if (SerialActors != CulledActors)
 		{
-			if (Request.Requestor && Request.Requestor->IsValidLowLevel())
-			{
-				//if failed, it will automatically re-added to pending list
-				SetTeamForPlayerController(Request.Requestor, Request.TeamName);
-			}
+			UE_LOG(LogLocusReplicationGraph, Error, TEXT("Parallel cull of %s differs from serial cull: %d vs %d actors"), *GetName(), CulledActors.Num(), SerialActors.Num());
 		}
 	}
 
-	if (PendingConnectionActors.Num() > 0)
+	if (CulledActors.Num() > 0)
 	{
-		TArray<AActor*> TempActors = MoveTemp(PendingConnectionActors);
-
-		for (AActor* Actor : TempActors)
+		if (!bCulledListBuilt)
 		{
-			if (Actor && Actor->IsValidLowLevel())
+			CulledList.PrepareForWrite(true);
+			for (FActorRepListType Actor : CulledActors)
 			{
-				if (UNetConnection* Connection = Actor->GetNetConnection())
-				{
-					//if failed, it will automatically re-added to pending list
-					EClassRepNodeMapping Policy = GetMappingPolicy(Actor->GetClass());
-					FGlobalActorReplicationInfo& GlobalInfo = GlobalActorReplicationInfoMap.Get(Actor);
-					RouteAddNetworkActorToConnectionNodes(Policy, FNewReplicatedActorInfo(Actor), GlobalInfo);
-				}
+				CulledList.Add(Actor);
 			}
+			bCulledListBuilt = true;
+		}
+		Params.OutGatheredReplicationLists.AddReplicationActorList(CulledList);
+
+		if (ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(&Params.ConnectionManager))
+		{
+			LocusConnManager->GatheredActors += CulledActors.Num();
 		}
 	}
 }
 
-
-class ULocusReplicationConnectionGraph* ULocusReplicationGraph::FindLocusConnectionGraph(const AActor* Actor)
+void UReplicationGraphNode_OwnerSpatialized::GetAllActorsInNode_Debugging(TArray<FActorRepListType>& OutArray) const
 {
-	if (Actor)
+	for (const FOwnedActor& OwnedActor : OwnedActors)
 	{
-		if (UNetConnection* NetConnection = Actor->GetNetConnection())
-		{
-			if (ULocusReplicationConnectionGraph* ConnManager = Cast<ULocusReplicationConnectionGraph>(FindOrAddConnectionManager(NetConnection)))
-			{
-				return ConnManager;
-			}
-		}
+		OutArray.Add(OwnedActor.Actor);
 	}
-	return nullptr;
 }
 
-#if WITH_GAMEPLAY_DEBUGGER
-void ULocusReplicationGraph::OnGameplayDebuggerOwnerChange(AGameplayDebuggerCategoryReplicator* Debugger, APlayerController* OldOwner)
+void UReplicationGraphNode_TeamSpatialized::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
 {
-	if (ULocusReplicationConnectionGraph* ConnManager = FindLocusConnectionGraph(OldOwner))
+	LOCUS_SCOPE_GATHER_STAT(Team, Params);
+	const FLocusScopedFollowGather FollowGather(Params, false);
+
+	ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(&Params.ConnectionManager);
+	if (LocusConnManager && LocusConnManager->TeamSharedNode)
 	{
-		FNewReplicatedActorInfo ActorInfo(Debugger);
-		ConnManager->AlwaysRelevantForConnectionNode->NotifyRemoveNetworkActor(ActorInfo);
+		//team grid already contains this connection's actors as well as teammates'
+		LocusConnManager->TeamSharedNode->TeamGridNode->GatherActorListsForConnection(Params);
+	}
+	else
+	{
+		Super::GatherActorListsForConnection(Params);
 	}
+}
 
-	if (ULocusReplicationConnectionGraph* ConnManager = FindLocusConnectionGraph(Debugger->GetReplicationOwner()))
+void UReplicationGraphNode_TeamSpatialized::AddAllActorsToGrid(UReplicationGraphNode_GridSpatialization2D_Layered* TeamGridNode)
+{
+	for (const FOwnedActor& OwnedActor : OwnedActors)
 	{
-		FNewReplicatedActorInfo ActorInfo(Debugger);
-		ConnManager->AlwaysRelevantForConnectionNode->NotifyAddNetworkActor(ActorInfo);
+		TeamGridNode->AddActor_Dynamic(FNewReplicatedActorInfo(OwnedActor.Actor), *OwnedActor.GlobalInfo);
 	}
 }
-#endif
 
-void ULocusReplicationGraph::PrintRepNodePolicies()
+void UReplicationGraphNode_TeamSpatialized::RemoveAllActorsFromGrid(UReplicationGraphNode_GridSpatialization2D_Layered* TeamGridNode)
 {
-	UEnum* Enum = FindObject<UEnum>(ANY_PACKAGE, TEXT("EClassRepNodeMapping"));
-	if (!Enum)
+	for (const FOwnedActor& OwnedActor : OwnedActors)
 	{
-		return;
+		TeamGridNode->RemoveActor_Dynamic(FNewReplicatedActorInfo(OwnedActor.Actor));
 	}
+}
 
-	GLog->Logf(TEXT("===================================="));
-	GLog->Logf(TEXT("Shooter Replication Routing Policies"));
-	GLog->Logf(TEXT("===================================="));
+//lists already gathered so far. none of the recorded gathers append fast shared lists
+static int32 NumDefaultLists(const FGatheredReplicationActorLists& Lists)
+{
+	return Lists.ContainsLists(EActorRepListTypeFlags::Default) ? Lists.GetLists(EActorRepListTypeFlags::Default).Num() : 0;
+}
 
-	for (auto It = ClassRepNodePolicies.CreateIterator(); It; ++It)
+FLocusScopedFollowGather::FLocusScopedFollowGather(const FConnectionGatherActorListParameters& InParams, bool bSpatial)
+	: Params(InParams)
+	, ConnManager(Cast<ULocusReplicationConnectionGraph>(&InParams.ConnectionManager))
+	, RecordList(nullptr)
+	, NumListsBefore(0)
+	, bSkip(false)
+{
+	if (!ConnManager || ConnManager->FollowGatherDepth++ > 0)
 	{
-		FObjectKey ObjKey = It.Key();
+		return;
+	}
 
-		EClassRepNodeMapping Mapping = It.Value();
+	if (bSpatial && ConnManager->GetGatheredFollowTarget(Params.ReplicationFrameNum))
+	{
+		bSkip = true;
+		return;
+	}
 
-		GLog->Logf(TEXT("%-40s --> %s"), *GetNameSafe(ObjKey.ResolveObjectPtr()), *Enum->GetNameStringByValue(static_cast<uint32>(Mapping)));
+	if (ConnManager->NumFollowers > 0)
+	{
+		if (ConnManager->FollowListFrame != Params.ReplicationFrameNum)
+		{
+			ConnManager->FollowSpatialList.PrepareForWrite(true);
+			ConnManager->FollowTeamList.PrepareForWrite(true);
+			ConnManager->FollowListFrame = Params.ReplicationFrameNum;
+		}
+		RecordList = bSpatial ? &ConnManager->FollowSpatialList : &ConnManager->FollowTeamList;
+		NumListsBefore = NumDefaultLists(Params.OutGatheredReplicationLists);
 	}
 }
 
-EClassRepNodeMapping ULocusReplicationGraph::GetMappingPolicy(UClass* Class)
+FLocusScopedFollowGather::~FLocusScopedFollowGather()
 {
-	EClassRepNodeMapping* PolicyPtr = ClassRepNodePolicies.Get(Class);
-	EClassRepNodeMapping Policy = PolicyPtr ? *PolicyPtr : EClassRepNodeMapping::NotRouted;
-	return Policy;
-}
+	if (!ConnManager)
+	{
+		return;
+	}
 
-void UReplicationGraphNode_AlwaysRelevant_ForTeam::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
-{
-	ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(&Params.ConnectionManager);
-	if (LocusConnManager && LocusConnManager->TeamName != NAME_None)
+	--ConnManager->FollowGatherDepth;
+	if (RecordList)
 	{
-		ULocusReplicationGraph* ReplicationGraph = Cast<ULocusReplicationGraph>(GetOuter());
-		if (TArray<ULocusReplicationConnectionGraph*>* TeamConnections = ReplicationGraph->TeamConnectionListMap.GetConnectionArrayForTeam(LocusConnManager->TeamName))
+		//copied once per followed connection, every follower appends the same list
+		const FGatheredReplicationActorLists& Lists = Params.OutGatheredReplicationLists;
+		const int32 NumLists = NumDefaultLists(Lists);
+		for (int32 ListIndex = NumListsBefore; ListIndex < NumLists; ++ListIndex)
 		{
-			for (ULocusReplicationConnectionGraph* TeamMember : *TeamConnections)
+			const auto& List = Lists.GetLists(EActorRepListTypeFlags::Default)[ListIndex];
+			for (int32 ActorIndex = 0; ActorIndex < List.Num(); ++ActorIndex)
 			{
-				//we call parent 
-				TeamMember->TeamConnectionNode->GatherActorListsForConnectionDefault(Params);
+				RecordList->Add(List[ActorIndex]);
 			}
 		}
 	}
-	else
+}
+
+void UReplicationGraphNode_ViewFollow::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LocusRepGraph_ViewFollowGather);
+	LOCUS_SCOPE_GATHER_STAT(ViewFollow, Params);
+
+	ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(&Params.ConnectionManager);
+	ULocusReplicationConnectionGraph* Target = LocusConnManager ? LocusConnManager->GetGatheredFollowTarget(Params.ReplicationFrameNum) : nullptr;
+	if (!Target)
 	{
-		Super::GatherActorListsForConnection(Params);
+		//target didn't gather this frame, follower's spatial nodes gathered from it's own view
+		return;
+	}
+
+	//follower skipped it's own spatial gathers for these
+	if (Target->FollowSpatialList.Num() > 0)
+	{
+		Params.OutGatheredReplicationLists.AddReplicationActorList(Target->FollowSpatialList);
+		LocusConnManager->GatheredActors += Target->FollowSpatialList.Num();
+	}
+
+	//teammates of target already gather the same team lists
+	const bool bSameTeam = Target->TeamSharedNode && LocusConnManager->TeamSharedNode == Target->TeamSharedNode;
+	if (!bSameTeam && Target->FollowTeamList.Num() > 0)
+	{
+		Params.OutGatheredReplicationLists.AddReplicationActorList(Target->FollowTeamList);
+		LocusConnManager->GatheredActors += Target->FollowTeamList.Num();
 	}
 }
 
@@ -713,38 +2908,106 @@ UReplicationGraphNode_AlwaysRelevant_WithPending::UReplicationGraphNode_AlwaysRe
 void UReplicationGraphNode_AlwaysRelevant_WithPending::PrepareForReplication()
 {
 	ULocusReplicationGraph* ReplicationGraph = Cast<ULocusReplicationGraph>(GetOuter());
+	ReplicationGraph->SampleStats();
+	ReplicationGraph->RecordTraceFrame();
+	ReplicationGraph->CompactConnectionLists();
+	ReplicationGraph->ApplyDependencyChanges();
+	ReplicationGraph->ProcessOwnerChanges();
+	ReplicationGraph->UpdateAdaptiveReplicationPeriods();
+	ReplicationGraph->RebalanceFrequencyBuckets();
+	ReplicationGraph->UpdateFollowTargets();
 	ReplicationGraph->HandlePendingActorsAndTeamRequests();
+	//after everything that routes actors, so culls are not stale by the time connections gather
+	ReplicationGraph->PrecullConnectionNodes();
+}
+
+int32 FLocusConnectionSlots::Add(ULocusReplicationConnectionGraph* ConnManager)
+{
+	int32 SlotIndex = FreeSlots.Num() > 0 ? FreeSlots.Pop(false) : Slots.AddUninitialized();
+	Slots[SlotIndex] = ConnManager;
+	SlotByConnection.Add(ConnManager->NetConnection, SlotIndex);
+	ConnManager->SlotIndex = SlotIndex;
+	return SlotIndex;
+}
+
+void FLocusConnectionSlots::Remove(ULocusReplicationConnectionGraph* ConnManager)
+{
+	if (Slots.IsValidIndex(ConnManager->SlotIndex) && Slots[ConnManager->SlotIndex] == ConnManager)
+	{
+		Slots[ConnManager->SlotIndex] = nullptr;
+		FreeSlots.Add(ConnManager->SlotIndex);
+		SlotByConnection.Remove(ConnManager->NetConnection);
+	}
+	ConnManager->SlotIndex = INDEX_NONE;
 }
 
-void UReplicationGraphNode_AlwaysRelevant_ForTeam::GatherActorListsForConnectionDefault(const FConnectionGatherActorListParameters& Params)
+ULocusReplicationConnectionGraph* FLocusConnectionSlots::Find(const UNetConnection* NetConnection) const
 {
-	Super::GatherActorListsForConnection(Params);
+	const int32* SlotIndex = SlotByConnection.Find(NetConnection);
+	return SlotIndex ? Slots[*SlotIndex] : nullptr;
 }
 
-TArray<class ULocusReplicationConnectionGraph*>* FTeamConnectionListMap::GetConnectionArrayForTeam(FName TeamName)
+void FLocusConnectionSlots::Reset()
 {
-	return Find(TeamName);
+	Slots.Reset();
+	FreeSlots.Reset();
+	SlotByConnection.Reset();
 }
 
-void FTeamConnectionListMap::AddConnectionToTeam(FName TeamName, ULocusReplicationConnectionGraph* ConnManager)
+
+void FLocusClassPolicyTable::Set(const UClass* Class, EClassRepNodeMapping Policy)
 {
-	TArray<class ULocusReplicationConnectionGraph*>& TeamList = FindOrAdd(TeamName);
-	TeamList.Add(ConnManager);
+	Policies.Add(FObjectKey(Class), Policy);
 }
 
-void FTeamConnectionListMap::RemoveConnectionFromTeam(FName TeamName, ULocusReplicationConnectionGraph* ConnManager)
+void FLocusClassPolicyTable::PurgeStale()
 {
-	if (TArray<class ULocusReplicationConnectionGraph*>* TeamList = Find(TeamName))
+	for (auto It = Policies.CreateIterator(); It; ++It)
 	{
-		TeamList->RemoveSwap(ConnManager);
-		//remove team if there's noone left
-		if (TeamList->Num() == 0)
+		if (!It.Key().ResolveObjectPtr())
 		{
-			Remove(TeamName);
+			It.RemoveCurrent();
 		}
 	}
 }
 
+void FLocusClassPolicyTable::Reset()
+{
+	Policies.Reset();
+}
+
+FLocusActorReplicationOverride& FLocusActorOverrideTable::FindOrAdd(const AActor* Actor)
+{
+	if (const int32* EntryIndex = EntryIndices.Find(Actor))
+	{
+		return Entries[*EntryIndex];
+	}
+
+	const int32 EntryIndex = FreeEntries.Num() > 0 ? FreeEntries.Pop(false) : Entries.AddDefaulted();
+	EntryIndices.Add(Actor, EntryIndex);
+	Entries[EntryIndex] = FLocusActorReplicationOverride();
+	return Entries[EntryIndex];
+}
+
+bool FLocusActorOverrideTable::Remove(const AActor* Actor)
+{
+	int32 EntryIndex = INDEX_NONE;
+	if (EntryIndices.Num() == 0 || !EntryIndices.RemoveAndCopyValue(Actor, EntryIndex))
+	{
+		return false;
+	}
+
+	FreeEntries.Add(EntryIndex);
+	return true;
+}
+
+void FLocusActorOverrideTable::Reset()
+{
+	Entries.Reset();
+	FreeEntries.Reset();
+	EntryIndices.Reset();
+}
+
 
 //console commands copied from shooter repgraph
 // ------------------------------------------------------------------------------
@@ -770,9 +3033,193 @@ FAutoConsoleCommandWithWorldAndArgs ChangeFrequencyBucketsCmd(TEXT("LocusRepGrap
 	}
 
 	UE_LOG(LogLocusReplicationGraph, Display, TEXT("Setting Frequency Buckets to %d"), Buckets);
+	//manual size would be overwritten by rebalancing
+	for (TObjectIterator<ULocusReplicationGraph> It; It; ++It)
+	{
+		It->bAdaptiveFrequencyBuckets = false;
+	}
 	for (TObjectIterator<UReplicationGraphNode_ActorListFrequencyBuckets> It; It; ++It)
 	{
 		UReplicationGraphNode_ActorListFrequencyBuckets* Node = *It;
 		Node->SetNonStreamingCollectionSize(Buckets);
 	}
 }));
+
+FAutoConsoleCommandWithWorldAndArgs PrintPolicyCacheStatsCmd(TEXT("LocusRepGraph.PolicyCacheStats"), TEXT("Prints hit/miss counts of class routing policy table"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+{
+	for (TObjectIterator<ULocusReplicationGraph> It; It; ++It)
+	{
+		It->PrintPolicyCacheStats();
+	}
+}));
+
+FAutoConsoleCommandWithWorldAndArgs PrintAdaptiveReplicationPeriodsCmd(TEXT("LocusRepGraph.AdaptivePeriods"), TEXT("Prints saturation and replication period multiplier of each connection"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+{
+	for (TObjectIterator<ULocusReplicationGraph> It; It; ++It)
+	{
+		It->PrintAdaptiveReplicationPeriods();
+	}
+}));
+
+FAutoConsoleCommandWithWorldAndArgs PrintStatsCmd(TEXT("LocusRepGraph.Stats"), TEXT("Prints rolling averages and percentiles of graph and connection stats. 'reset' clears them"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+{
+	const bool bReset = Args.Num() > 0 && Args[0] == TEXT("reset");
+	for (TObjectIterator<ULocusReplicationGraph> It; It; ++It)
+	{
+		if (bReset)
+		{
+			It->ResetStats();
+		}
+		else
+		{
+			It->PrintStats();
+		}
+	}
+}));
+
+FAutoConsoleCommandWithWorldAndArgs TraceCmd(TEXT("LocusRepGraph.Trace"), TEXT("'start [Filename]' streams graph inputs to a trace file for replay, 'stop' closes it"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+{
+	if (Args.Num() == 0 || (Args[0] != TEXT("start") && Args[0] != TEXT("stop")))
+	{
+		UE_LOG(LogLocusReplicationGraph, Display, TEXT("Usage: LocusRepGraph.Trace start [Filename] | stop"));
+		return;
+	}
+
+	for (TObjectIterator<ULocusReplicationGraph> It; It; ++It)
+	{
+		if (It->HasAnyFlags(RF_ClassDefaultObject) || !It->GetWorld() || (World && It->GetWorld() != World))
+		{
+			continue;
+		}
+
+		if (Args[0] == TEXT("start"))
+		{
+			It->StartTrace(Args.Num() > 1 ? Args[1] : FString());
+		}
+		else
+		{
+			It->StopTrace();
+		}
+	}
+}));
+
+FAutoConsoleCommandWithWorldAndArgs PrintActorOverridesCmd(TEXT("LocusRepGraph.ActorOverrides"), TEXT("Prints per actor replication info overrides"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+{
+	for (TObjectIterator<ULocusReplicationGraph> It; It; ++It)
+	{
+		if (!It->HasAnyFlags(RF_ClassDefaultObject) && It->GetWorld())
+		{
+			It->PrintActorOverrides();
+		}
+	}
+}));
+
+static UClass* FindActorClassByName(const FString& ClassName)
+{
+	UClass* Class = ClassName.Contains(TEXT("/")) ? LoadObject<UClass>(nullptr, *ClassName) : FindObject<UClass>(ANY_PACKAGE, *ClassName);
+	if (!Class || !Class->IsChildOf(AActor::StaticClass()))
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Actor class %s not found"), *ClassName);
+		return nullptr;
+	}
+	return Class;
+}
+
+FAutoConsoleCommandWithWorldAndArgs ReloadClassSettingsCmd(TEXT("LocusRepGraph.ReloadClassSettings"), TEXT("Applies policy and info presets of graph class defaults to running graph"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+{
+	for (TObjectIterator<ULocusReplicationGraph> It; It; ++It)
+	{
+		if (!It->HasAnyFlags(RF_ClassDefaultObject) && It->GetWorld())
+		{
+			It->ReloadClassSettings();
+		}
+	}
+}));
+
+FAutoConsoleCommandWithWorldAndArgs SetClassPolicyCmd(TEXT("LocusRepGraph.SetClassPolicy"), TEXT("<Class> <Policy>. Sets routing policy preset of a class at runtime, e.g. LocusRepGraph.SetClassPolicy BP_Pickup_C Spatialize_Dormancy"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+{
+	if (Args.Num() < 2)
+	{
+		UE_LOG(LogLocusReplicationGraph, Display, TEXT("Usage: LocusRepGraph.SetClassPolicy <Class> <Policy>"));
+		return;
+	}
+
+	UClass* Class = FindActorClassByName(Args[0]);
+	const int64 PolicyValue = StaticEnum<EClassRepNodeMapping>()->GetValueByNameString(Args[1]);
+	if (!Class || PolicyValue == INDEX_NONE)
+	{
+		UE_CLOG(PolicyValue == INDEX_NONE, LogLocusReplicationGraph, Warning, TEXT("Unknown policy %s"), *Args[1]);
+		return;
+	}
+
+	for (TObjectIterator<ULocusReplicationGraph> It; It; ++It)
+	{
+		if (It->HasAnyFlags(RF_ClassDefaultObject) || !It->GetWorld())
+		{
+			continue;
+		}
+
+		//last preset of a class wins
+		TArray<FClassReplicationPolicyPreset> PolicySettings = It->ReplicationPolicySettings;
+		FClassReplicationPolicyPreset& Preset = PolicySettings.AddDefaulted_GetRef();
+		Preset.Class = Class;
+		Preset.Policy = (EClassRepNodeMapping)PolicyValue;
+		It->ApplyClassSettings(PolicySettings, It->ReplicationInfoSettings);
+	}
+}));
+
+FAutoConsoleCommandWithWorldAndArgs SetClassInfoCmd(TEXT("LocusRepGraph.SetClassInfo"), TEXT("<Class> <Field>=<Value>... Sets replication info preset fields of a class at runtime, e.g. LocusRepGraph.SetClassInfo BP_Pickup_C CullDistanceSquared=25000000 ReplicationPeriodFrame=4"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+{
+	if (Args.Num() < 2)
+	{
+		UE_LOG(LogLocusReplicationGraph, Display, TEXT("Usage: LocusRepGraph.SetClassInfo <Class> <Field>=<Value>..."));
+		return;
+	}
+
+	UClass* Class = FindActorClassByName(Args[0]);
+	if (!Class)
+	{
+		return;
+	}
+
+	for (TObjectIterator<ULocusReplicationGraph> It; It; ++It)
+	{
+		if (It->HasAnyFlags(RF_ClassDefaultObject) || !It->GetWorld())
+		{
+			continue;
+		}
+
+		FClassReplicationInfoPreset Preset = It->GetClassInfoPreset(Class);
+		for (int32 ArgIndex = 1; ArgIndex < Args.Num(); ++ArgIndex)
+		{
+			FString FieldName, Value;
+			FProperty* Property = Args[ArgIndex].Split(TEXT("="), &FieldName, &Value) ? FindFProperty<FProperty>(FClassReplicationInfoPreset::StaticStruct(), *FieldName) : nullptr;
+			if (!Property || FieldName == TEXT("Class") || !Property->ImportText(*Value, Property->ContainerPtrToValuePtr<void>(&Preset), PPF_None, nullptr))
+			{
+				UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Invalid field assignment %s"), *Args[ArgIndex]);
+				return;
+			}
+		}
+
+		//first preset of a class wins, replace it in place
+		TArray<FClassReplicationInfoPreset> InfoSettings = It->ReplicationInfoSettings;
+		const int32 PresetIndex = InfoSettings.IndexOfByPredicate([Class](const FClassReplicationInfoPreset& Existing) { return Existing.Class == Class; });
+		if (PresetIndex != INDEX_NONE)
+		{
+			InfoSettings[PresetIndex] = Preset;
+		}
+		else
+		{
+			InfoSettings.Add(Preset);
+		}
+		It->ApplyClassSettings(It->ReplicationPolicySettings, InfoSettings);
+	}
+}));
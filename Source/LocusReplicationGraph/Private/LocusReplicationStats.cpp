@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LocusReplicationStats.h"
+
+const TCHAR* LexToString(ELocusGatherStat Stat)
+{
+	switch (Stat)
+	{
+	case ELocusGatherStat::Grid: return TEXT("Grid");
+	case ELocusGatherStat::Voxel: return TEXT("Voxel");
+	case ELocusGatherStat::PVS: return TEXT("PVS");
+	case ELocusGatherStat::TeamVision: return TEXT("TeamVision");
+	case ELocusGatherStat::Owner: return TEXT("Owner");
+	case ELocusGatherStat::Team: return TEXT("Team");
+	case ELocusGatherStat::ViewFollow: return TEXT("ViewFollow");
+	default: return TEXT("Unknown");
+	}
+}
+
+void FLocusStatBuffer::Add(float Value)
+{
+	if (Samples.Num() < Capacity)
+	{
+		Samples.Add(Value);
+	}
+	else
+	{
+		Samples[NextIndex] = Value;
+	}
+	NextIndex = (NextIndex + 1) % Capacity;
+}
+
+void FLocusStatBuffer::Reset()
+{
+	Samples.Reset();
+	NextIndex = 0;
+}
+
+float FLocusStatBuffer::GetAverage() const
+{
+	if (Samples.Num() == 0)
+	{
+		return 0.f;
+	}
+
+	double Sum = 0.0;
+	for (float Sample : Samples)
+	{
+		Sum += Sample;
+	}
+	return Sum / Samples.Num();
+}
+
+float FLocusStatBuffer::GetMax() const
+{
+	float Max = 0.f;
+	for (float Sample : Samples)
+	{
+		Max = FMath::Max(Max, Sample);
+	}
+	return Max;
+}
+
+float FLocusStatBuffer::GetPercentile(float Percentile) const
+{
+	if (Samples.Num() == 0)
+	{
+		return 0.f;
+	}
+
+	//only sorted when printed
+	TArray<float> Sorted = Samples;
+	Sorted.Sort();
+	const int32 Rank = FMath::CeilToInt(FMath::Clamp(Percentile, 0.f, 1.f) * Sorted.Num()) - 1;
+	return Sorted[FMath::Clamp(Rank, 0, Sorted.Num() - 1)];
+}
+
+void FLocusReplicationGraphStats::EndFrame()
+{
+	RouteAddMs.Add(FPlatformTime::ToMilliseconds64(RouteAddCycles));
+	RouteRemoveMs.Add(FPlatformTime::ToMilliseconds64(RouteRemoveCycles));
+	PendingMs.Add(FPlatformTime::ToMilliseconds64(PendingCycles));
+	for (int32 StatIndex = 0; StatIndex < (int32)ELocusGatherStat::Num; ++StatIndex)
+	{
+		GatherMs[StatIndex].Add(FPlatformTime::ToMilliseconds64(GatherCycles[StatIndex]));
+		GatherCycles[StatIndex] = 0;
+	}
+	RouteAdds.Add(NumRouteAdds);
+	RouteRemoves.Add(NumRouteRemoves);
+
+	RouteAddCycles = 0;
+	RouteRemoveCycles = 0;
+	PendingCycles = 0;
+	NumRouteAdds = 0;
+	NumRouteRemoves = 0;
+}
+
+void FLocusReplicationGraphStats::Reset()
+{
+	*this = FLocusReplicationGraphStats();
+}
+
+void FLocusReplicationGraphStats::PrintBuffer(const TCHAR* Name, const FLocusStatBuffer& Buffer)
+{
+	GLog->Logf(TEXT("  %-24s avg %9.3f  p50 %9.3f  p95 %9.3f  p99 %9.3f  max %9.3f  (%d frames)"), Name,
+		Buffer.GetAverage(), Buffer.GetPercentile(0.5f), Buffer.GetPercentile(0.95f), Buffer.GetPercentile(0.99f), Buffer.GetMax(), Buffer.Num());
+}
@@ -0,0 +1,596 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LocusReplicationTrace.h"
+#include "LocusReplicationBenchmark.h"
+#include "LocusReplicationGraph.h"
+#include "Async/Async.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/WorldSettings.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+
+//background write starts when buffer grows past this
+static const int32 TraceFlushSize = 256 * 1024;
+
+TUniquePtr<FLocusTraceWriter> FLocusTraceWriter::Create(const FString& Filename, const FString& GraphClassPath, const FBox2D& SpatialBounds)
+{
+	FArchive* Archive = IFileManager::Get().CreateFileWriter(*Filename);
+	if (!Archive)
+	{
+		return nullptr;
+	}
+
+	TUniquePtr<FLocusTraceWriter> Writer(new FLocusTraceWriter(Filename, Archive));
+
+	FHeader Header;
+	Header.Magic = FileMagic;
+	Header.Version = FileVersion;
+	Writer->Write(Header);
+	Writer->WriteString(GraphClassPath);
+	//inverted box when graph has no bounds
+	const FBox2D Bounds = SpatialBounds.bIsValid ? SpatialBounds : FBox2D(FVector2D(1.f, 1.f), FVector2D(-1.f, -1.f));
+	Writer->Write((float)Bounds.Min.X);
+	Writer->Write((float)Bounds.Min.Y);
+	Writer->Write((float)Bounds.Max.X);
+	Writer->Write((float)Bounds.Max.Y);
+	return Writer;
+}
+
+FLocusTraceWriter::FLocusTraceWriter(const FString& InFilename, FArchive* InArchive)
+	: Filename(InFilename)
+	, Archive(InArchive)
+{
+	Buffer.Reserve(TraceFlushSize * 2);
+}
+
+FLocusTraceWriter::~FLocusTraceWriter()
+{
+	Flush(true);
+
+	//frame count lets replay size it's buffers up front
+	Archive->Seek(STRUCT_OFFSET(FHeader, NumFrames));
+	*Archive << NumFrames;
+	Archive->Close();
+}
+
+void FLocusTraceWriter::Flush(bool bWait)
+{
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+		PendingWrite.Reset();
+	}
+
+	if (Buffer.Num() == 0)
+	{
+		return;
+	}
+
+	TotalBytes += Buffer.Num();
+	Swap(Buffer, WriteBuffer);
+	Buffer.Reset();
+
+	if (bWait)
+	{
+		Archive->Serialize(WriteBuffer.GetData(), WriteBuffer.Num());
+		return;
+	}
+
+	//only one write in flight, so WriteBuffer and Archive are not touched by game thread until it's done
+	PendingWrite = Async(EAsyncExecution::ThreadPool, [this]()
+	{
+		Archive->Serialize(WriteBuffer.GetData(), WriteBuffer.Num());
+	});
+}
+
+void FLocusTraceWriter::WriteVector(const FVector& Vector)
+{
+	//float on disk regardless of engine precision
+	Write((float)Vector.X);
+	Write((float)Vector.Y);
+	Write((float)Vector.Z);
+}
+
+void FLocusTraceWriter::WriteString(const FString& String)
+{
+	FTCHARToUTF8 Converted(*String);
+	const uint16 Length = (uint16)FMath::Min(Converted.Length(), (int32)MAX_uint16);
+	Write(Length);
+	Buffer.Append((const uint8*)Converted.Get(), Length);
+}
+
+uint32 FLocusTraceWriter::GetActorId(AActor* Actor)
+{
+	if (!Actor)
+	{
+		return 0;
+	}
+
+	FTracedActor& Traced = Actors.FindOrAdd(FObjectKey(Actor));
+	if (Traced.Id == 0)
+	{
+		Traced.Actor = Actor;
+		Traced.Id = NextActorId++;
+	}
+	return Traced.Id;
+}
+
+uint32 FLocusTraceWriter::GetConnectionId(const UObject* Connection)
+{
+	if (!Connection)
+	{
+		return 0;
+	}
+
+	uint32& Id = Connections.FindOrAdd(FObjectKey(Connection));
+	if (Id == 0)
+	{
+		Id = NextConnectionId++;
+	}
+	return Id;
+}
+
+uint32 FLocusTraceWriter::GetStringId(const FString& String)
+{
+	if (uint32* Id = Strings.Find(String))
+	{
+		return *Id;
+	}
+
+	const uint32 Id = NextStringId++;
+	Strings.Add(String, Id);
+	WriteRecord(ELocusTraceRecord::String);
+	Write(Id);
+	WriteString(String);
+	return Id;
+}
+
+void FLocusTraceWriter::AddActor(AActor* Actor, AActor* Owner)
+{
+	const uint32 ClassId = GetStringId(Actor->GetClass()->GetPathName());
+	const uint32 OwnerId = GetActorId(Owner);
+	const uint32 ActorId = GetActorId(Actor);
+
+	FTracedActor& Traced = Actors.FindChecked(FObjectKey(Actor));
+	Traced.bRouted = true;
+	//connection PlayerControllers are replayed from viewer locations
+	Traced.bTrackMovement = !Actor->IsA<APlayerController>();
+	Traced.Location = Actor->GetActorLocation();
+
+	WriteRecord(ELocusTraceRecord::AddActor);
+	Write(ActorId);
+	Write(ClassId);
+	Write(OwnerId);
+	WriteVector(Traced.Location);
+}
+
+void FLocusTraceWriter::RemoveActor(AActor* Actor)
+{
+	FTracedActor Traced;
+	if (Actors.RemoveAndCopyValue(FObjectKey(Actor), Traced))
+	{
+		WriteRecord(ELocusTraceRecord::RemoveActor);
+		Write(Traced.Id);
+	}
+}
+
+void FLocusTraceWriter::AddConnection(const UObject* Connection)
+{
+	WriteRecord(ELocusTraceRecord::AddConnection);
+	Write(GetConnectionId(Connection));
+}
+
+void FLocusTraceWriter::RemoveConnection(const UObject* Connection)
+{
+	uint32 Id = 0;
+	if (Connections.RemoveAndCopyValue(FObjectKey(Connection), Id))
+	{
+		WriteRecord(ELocusTraceRecord::RemoveConnection);
+		Write(Id);
+	}
+}
+
+void FLocusTraceWriter::SetConnectionPlayerController(const UObject* Connection, APlayerController* PlayerController)
+{
+	const uint32 ActorId = GetActorId(PlayerController);
+	WriteRecord(ELocusTraceRecord::ConnectionPlayerController);
+	Write(GetConnectionId(Connection));
+	Write(ActorId);
+}
+
+void FLocusTraceWriter::SetTeam(APlayerController* PlayerController, FName TeamName)
+{
+	const uint32 TeamId = TeamName == NAME_None ? 0 : GetStringId(TeamName.ToString());
+	const uint32 ActorId = GetActorId(PlayerController);
+	WriteRecord(ELocusTraceRecord::SetTeam);
+	Write(ActorId);
+	Write(TeamId);
+}
+
+void FLocusTraceWriter::ChangeOwner(AActor* Actor, AActor* NewOwner)
+{
+	const uint32 ActorId = GetActorId(Actor);
+	const uint32 OwnerId = GetActorId(NewOwner);
+	WriteRecord(ELocusTraceRecord::ChangeOwner);
+	Write(ActorId);
+	Write(OwnerId);
+}
+
+void FLocusTraceWriter::SetDependentActor(AActor* ReplicatorActor, AActor* DependentActor, bool bAdd)
+{
+	const uint32 ReplicatorId = GetActorId(ReplicatorActor);
+	const uint32 DependentId = GetActorId(DependentActor);
+	WriteRecord(bAdd ? ELocusTraceRecord::AddDependent : ELocusTraceRecord::RemoveDependent);
+	Write(ReplicatorId);
+	Write(DependentId);
+}
+
+void FLocusTraceWriter::ViewerLocation(const UObject* Connection, const FVector& ViewLocation)
+{
+	WriteRecord(ELocusTraceRecord::ViewerLocation);
+	Write(GetConnectionId(Connection));
+	WriteVector(ViewLocation);
+}
+
+void FLocusTraceWriter::UpdateActorLocations(float Threshold)
+{
+	const float ThresholdSquared = FMath::Square(Threshold);
+	for (auto It = Actors.CreateIterator(); It; ++It)
+	{
+		FTracedActor& Traced = It.Value();
+		AActor* Actor = Traced.Actor.Get();
+		if (!Actor)
+		{
+			//replay removes it as well, routed or not it can't be referenced again
+			if (Traced.bRouted)
+			{
+				WriteRecord(ELocusTraceRecord::RemoveActor);
+				Write(Traced.Id);
+			}
+			It.RemoveCurrent();
+			continue;
+		}
+
+		if (!Traced.bTrackMovement)
+		{
+			continue;
+		}
+
+		const FVector Location = Actor->GetActorLocation();
+		if (FVector::DistSquared(Location, Traced.Location) > ThresholdSquared)
+		{
+			Traced.Location = Location;
+			WriteRecord(ELocusTraceRecord::MoveActor);
+			Write(Traced.Id);
+			WriteVector(Location);
+		}
+	}
+}
+
+void FLocusTraceWriter::MarkFrame(uint32 FrameNum, float DeltaSeconds)
+{
+	++NumFrames;
+	WriteRecord(ELocusTraceRecord::Frame);
+	Write(FrameNum);
+	Write(DeltaSeconds);
+
+	if (Buffer.Num() >= TraceFlushSize)
+	{
+		Flush(false);
+	}
+}
+
+bool FLocusTraceReplay::Load(const FString& InFilename)
+{
+	Filename = InFilename;
+	if (!FFileHelper::LoadFileToArray(Data, *Filename))
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("Could not read trace %s"), *Filename);
+		return false;
+	}
+
+	Offset = 0;
+	FLocusTraceWriter::FHeader Header;
+	float MinX, MinY, MaxX, MaxY;
+	if (!Read(Header) || Header.Magic != FLocusTraceWriter::FileMagic || Header.Version != FLocusTraceWriter::FileVersion
+		|| !ReadString(GraphClassPath) || !Read(MinX) || !Read(MinY) || !Read(MaxX) || !Read(MaxY))
+	{
+		UE_LOG(LogLocusReplicationGraph, Error, TEXT("%s is not a trace of this version"), *Filename);
+		return false;
+	}
+
+	SpatialBounds = FBox2D(FVector2D(MinX, MinY), FVector2D(MaxX, MaxY));
+	if (MinX > MaxX || MinY > MaxY)
+	{
+		SpatialBounds = FBox2D(ForceInit);
+	}
+
+	NumFrames = Header.NumFrames;
+	UE_CLOG(NumFrames == 0, LogLocusReplicationGraph, Warning, TEXT("Trace %s was not closed, replaying it up to the last complete record"), *Filename);
+
+	RecordsOffset = Offset;
+	return true;
+}
+
+bool FLocusTraceReplay::ReadVector(FVector& Vector)
+{
+	float X, Y, Z;
+	if (!Read(X) || !Read(Y) || !Read(Z))
+	{
+		return false;
+	}
+	Vector = FVector(X, Y, Z);
+	return true;
+}
+
+bool FLocusTraceReplay::ReadString(FString& String)
+{
+	uint16 Length = 0;
+	if (!Read(Length) || Offset + Length > Data.Num())
+	{
+		return false;
+	}
+
+	FUTF8ToTCHAR Converted((const ANSICHAR*)Data.GetData() + Offset, Length);
+	String = FString(Converted.Length(), Converted.Get());
+	Offset += Length;
+	return true;
+}
+
+UClass* FLocusTraceReplay::FindClass(uint32 ClassId)
+{
+	if (UClass** Class = Classes.Find(ClassId))
+	{
+		return *Class;
+	}
+
+	const FString* ClassPath = Strings.Find(ClassId);
+	UClass* Class = ClassPath ? LoadObject<UClass>(nullptr, **ClassPath) : nullptr;
+	if (!Class || !Class->IsChildOf(AActor::StaticClass()))
+	{
+		MissingClasses.Add(ClassPath ? *ClassPath : FString::Printf(TEXT("#%u"), ClassId));
+		Class = nullptr;
+	}
+	Classes.Add(ClassId, Class);
+	return Class;
+}
+
+bool FLocusTraceReplay::Run(FLocusReplicationBenchmark& Benchmark)
+{
+	ULocusReplicationGraph* Graph = Benchmark.GetGraph();
+	const double StartTime = FPlatformTime::Seconds();
+
+	auto SetActor = [this](uint32 ActorId, AActor* Actor)
+	{
+		if (ActorId >= (uint32)ReplayActors.Num())
+		{
+			ReplayActors.SetNumZeroed(ActorId + 1);
+		}
+		ReplayActors[ActorId] = Actor;
+	};
+	auto FindConnection = [this](uint32 ConnectionId)
+	{
+		return ConnectionId < (uint32)ReplayConnections.Num() ? ReplayConnections[ConnectionId] : nullptr;
+	};
+
+	Offset = RecordsOffset;
+	while (Offset < Data.Num())
+	{
+		const int64 RecordOffset = Offset;
+		uint8 RecordType = 0;
+		Read(RecordType);
+
+		bool bOk = true;
+		switch ((ELocusTraceRecord)RecordType)
+		{
+		case ELocusTraceRecord::String:
+		{
+			uint32 Id = 0;
+			FString String;
+			bOk = Read(Id) && ReadString(String);
+			Strings.Add(Id, String);
+			break;
+		}
+
+		case ELocusTraceRecord::Frame:
+		{
+			uint32 FrameNum = 0;
+			float DeltaSeconds = 0.f;
+			bOk = Read(FrameNum) && Read(DeltaSeconds);
+
+			if (bOk)
+			{
+				Benchmark.ReplicateFrame(DeltaSeconds);
+			}
+			break;
+		}
+
+		case ELocusTraceRecord::AddActor:
+		{
+			uint32 ActorId = 0, ClassId = 0, OwnerId = 0;
+			FVector Location;
+			bOk = Read(ActorId) && Read(ClassId) && Read(OwnerId) && ReadVector(Location);
+			if (!bOk)
+			{
+				break;
+			}
+
+			//connection PlayerControllers come from AddConnection, world settings exist already
+			UClass* Class = FindClass(ClassId);
+			if (!Class || Class->HasAnyClassFlags(CLASS_Abstract) || Class->IsChildOf(APlayerController::StaticClass()) || Class->IsChildOf(AWorldSettings::StaticClass()))
+			{
+				++NumSkipped;
+				break;
+			}
+
+			if (AActor* Actor = Benchmark.SpawnActor(Class, Location, FindActor(OwnerId)))
+			{
+				SetActor(ActorId, Actor);
+				++NumSpawned;
+			}
+			break;
+		}
+
+		case ELocusTraceRecord::RemoveActor:
+		{
+			uint32 ActorId = 0;
+			bOk = Read(ActorId);
+			AActor* Actor = FindActor(ActorId);
+			if (Actor && !Actor->IsA<APlayerController>())
+			{
+				Benchmark.DestroyActor(Actor);
+			}
+			if (Actor)
+			{
+				ReplayActors[ActorId] = nullptr;
+			}
+			break;
+		}
+
+		case ELocusTraceRecord::MoveActor:
+		{
+			uint32 ActorId = 0;
+			FVector Location;
+			bOk = Read(ActorId) && ReadVector(Location);
+			if (AActor* Actor = FindActor(ActorId))
+			{
+				Actor->SetActorLocation(Location);
+			}
+			break;
+		}
+
+		case ELocusTraceRecord::AddConnection:
+		{
+			uint32 ConnectionId = 0;
+			bOk = Read(ConnectionId);
+			if (bOk)
+			{
+				if (ConnectionId >= (uint32)ReplayConnections.Num())
+				{
+					ReplayConnections.SetNumZeroed(ConnectionId + 1);
+				}
+				ReplayConnections[ConnectionId] = Benchmark.AddConnection(FVector::ZeroVector);
+			}
+			break;
+		}
+
+		case ELocusTraceRecord::RemoveConnection:
+		{
+			uint32 ConnectionId = 0;
+			bOk = Read(ConnectionId);
+			if (APlayerController* PlayerController = FindConnection(ConnectionId))
+			{
+				Benchmark.RemoveConnection(PlayerController);
+				ReplayConnections[ConnectionId] = nullptr;
+			}
+			break;
+		}
+
+		case ELocusTraceRecord::ConnectionPlayerController:
+		{
+			uint32 ConnectionId = 0, ActorId = 0;
+			bOk = Read(ConnectionId) && Read(ActorId);
+			if (bOk && ActorId > 0)
+			{
+				SetActor(ActorId, FindConnection(ConnectionId));
+			}
+			break;
+		}
+
+		case ELocusTraceRecord::ViewerLocation:
+		{
+			uint32 ConnectionId = 0;
+			FVector Location;
+			bOk = Read(ConnectionId) && ReadVector(Location);
+			if (APlayerController* PlayerController = FindConnection(ConnectionId))
+			{
+				PlayerController->SetActorLocation(Location);
+			}
+			break;
+		}
+
+		case ELocusTraceRecord::SetTeam:
+		{
+			uint32 ActorId = 0, TeamId = 0;
+			bOk = Read(ActorId) && Read(TeamId);
+			if (APlayerController* PlayerController = Cast<APlayerController>(FindActor(ActorId)))
+			{
+				const FString* TeamName = Strings.Find(TeamId);
+				Graph->SetTeamForPlayerController(PlayerController, TeamName ? FName(**TeamName) : NAME_None);
+			}
+			break;
+		}
+
+		case ELocusTraceRecord::ChangeOwner:
+		{
+			uint32 ActorId = 0, OwnerId = 0;
+			bOk = Read(ActorId) && Read(OwnerId);
+			if (AActor* Actor = FindActor(ActorId))
+			{
+				Graph->ChangeOwnerOfAnActor(Actor, FindActor(OwnerId));
+			}
+			break;
+		}
+
+		case ELocusTraceRecord::AddDependent:
+		case ELocusTraceRecord::RemoveDependent:
+		{
+			uint32 ReplicatorId = 0, DependentId = 0;
+			bOk = Read(ReplicatorId) && Read(DependentId);
+			AActor* ReplicatorActor = FindActor(ReplicatorId);
+			AActor* DependentActor = FindActor(DependentId);
+			if ((ELocusTraceRecord)RecordType == ELocusTraceRecord::AddDependent)
+			{
+				Graph->AddDependentActor(ReplicatorActor, DependentActor);
+			}
+			else if (DependentId == 0)
+			{
+				Graph->RemoveAllDependentActors(ReplicatorActor);
+			}
+			else
+			{
+				Graph->RemoveDependentActor(ReplicatorActor, DependentActor);
+			}
+			break;
+		}
+
+		default:
+		{
+			bOk = false;
+			break;
+		}
+		}
+
+		if (!bOk)
+		{
+			//an unclosed trace ends with a partial record
+			UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Trace %s has invalid record %d at offset %lld"), *Filename, RecordType, RecordOffset);
+			ReplaySeconds = FPlatformTime::Seconds() - StartTime;
+			return NumFrames == 0;
+		}
+		++NumRecords;
+	}
+
+	ReplaySeconds = FPlatformTime::Seconds() - StartTime;
+	return true;
+}
+
+TSharedRef<FJsonObject> FLocusTraceReplay::GetResults() const
+{
+	TSharedRef<FJsonObject> Results = MakeShared<FJsonObject>();
+	Results->SetStringField(TEXT("file"), Filename);
+	Results->SetStringField(TEXT("traced_graph"), GraphClassPath);
+	Results->SetNumberField(TEXT("frames"), NumFrames);
+	Results->SetNumberField(TEXT("records"), NumRecords);
+	Results->SetNumberField(TEXT("spawned_actors"), NumSpawned);
+	Results->SetNumberField(TEXT("skipped_actors"), NumSkipped);
+	Results->SetNumberField(TEXT("replay_seconds"), ReplaySeconds);
+
+	TArray<TSharedPtr<FJsonValue>> MissingClassValues;
+	for (const FString& ClassPath : MissingClasses)
+	{
+		MissingClassValues.Add(MakeShared<FJsonValueString>(ClassPath));
+	}
+	Results->SetArrayField(TEXT("missing_classes"), MissingClassValues);
+	return Results;
+}
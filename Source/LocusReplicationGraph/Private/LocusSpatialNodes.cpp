@@ -0,0 +1,825 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "LocusSpatialNodes.h"
+#include "LocusReplicationGraph.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Out of bounds actors"), STAT_LocusRepGraph_OutOfBoundsActors, STATGROUP_LocusReplicationGraph);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Grid static path actors"), STAT_LocusRepGraph_GridStaticActors, STATGROUP_LocusReplicationGraph);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Grid dynamic path actors"), STAT_LocusRepGraph_GridDynamicActors, STATGROUP_LocusReplicationGraph);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Grid dormancy path actors"), STAT_LocusRepGraph_GridDormancyActors, STATGROUP_LocusReplicationGraph);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Grid auto path changes"), STAT_LocusRepGraph_GridAutoPathChanges, STATGROUP_LocusReplicationGraph);
+
+void UReplicationGraphNode_LocusFrequencyBuckets::Initialize(const TSharedPtr<FReplicationGraphGlobalData>& InGraphGlobals)
+{
+	Super::Initialize(InGraphGlobals);
+
+	if (ULocusReplicationGraph* LocusGraph = Cast<ULocusReplicationGraph>(InGraphGlobals->ReplicationGraph))
+	{
+		LocusGraph->RegisterFrequencyBucketNode(this);
+	}
+}
+
+UReplicationGraphNode_GridLayer::UReplicationGraphNode_GridLayer()
+{
+	CreateCellNodeOverride = [](UReplicationGraphNode_GridSpatialization2D* Parent)
+	{
+		UReplicationGraphNode_GridCell* Cell = Parent->CreateChildNode<UReplicationGraphNode_GridCell>();
+		Cell->CreateDynamicNodeOverride = [](UReplicationGraphNode_GridCell* CellParent) -> UReplicationGraphNode*
+		{
+			return CellParent->CreateChildNode<UReplicationGraphNode_LocusFrequencyBuckets>();
+		};
+		return Cell;
+	};
+}
+
+void UReplicationGraphNode_GridLayer::PreallocateGrid(const FBox2D& Bounds)
+{
+	//very small cells over huge worlds would cost more memory than the growth they save
+	const int32 MaxCellsPerAxis = 1024;
+	const FVector2D Size = Bounds.GetSize();
+	const int32 NumX = FMath::Min(FMath::CeilToInt(Size.X / CellSize) + 1, MaxCellsPerAxis);
+	const int32 NumY = FMath::Min(FMath::CeilToInt(Size.Y / CellSize) + 1, MaxCellsPerAxis);
+
+	if (Grid.Num() < NumX)
+	{
+		Grid.SetNum(NumX);
+	}
+	for (TArray<UReplicationGraphNode_GridCell*>& GridX : Grid)
+	{
+		if (GridX.Num() < NumY)
+		{
+			GridX.SetNum(NumY);
+		}
+	}
+}
+
+UReplicationGraphNode_GridSpatialization2D_Layered::UReplicationGraphNode_GridSpatialization2D_Layered()
+{
+	bRequiresPrepareForReplicationCall = true;
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::InitLayers(TArray<float> CellSizes, const FVector2D& SpatialBias, bool bEnableSpatialRebuilds, float MaxCellsPerCullDistance)
+{
+	CellSizes.Sort();
+	DefaultSpatialBias = SpatialBias;
+
+	for (float CellSize : CellSizes)
+	{
+		UReplicationGraphNode_GridLayer* Layer = CreateChildNode<UReplicationGraphNode_GridLayer>();
+		Layer->CellSize = CellSize;
+		Layer->SpatialBias = SpatialBias;
+
+		if (!bEnableSpatialRebuilds)
+		{
+			Layer->AddSpatialRebuildBlacklistClass(AActor::StaticClass()); // Disable All spatial rebuilding
+		}
+
+		Layers.Add(Layer);
+		LayerMaxCullDistances.Add(CellSize * MaxCellsPerCullDistance);
+	}
+
+	OverflowNode = CreateChildNode<UReplicationGraphNode_ActorList>();
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::SetSpatialBounds(const FBox2D& Bounds)
+{
+	SpatialBounds = Bounds;
+
+	for (UReplicationGraphNode_GridLayer* Layer : Layers)
+	{
+		Layer->SpatialBias = GetSpatialBias();
+		if (SpatialBounds.bIsValid)
+		{
+			Layer->PreallocateGrid(SpatialBounds);
+		}
+	}
+}
+
+int32 UReplicationGraphNode_GridSpatialization2D_Layered::GetLayerIndex(const FGlobalActorReplicationInfo& ActorRepInfo) const
+{
+	const float CullDistance = ActorRepInfo.Settings.GetCullDistance();
+	for (int32 LayerIndex = 0; LayerIndex < LayerMaxCullDistances.Num(); ++LayerIndex)
+	{
+		if (CullDistance <= LayerMaxCullDistances[LayerIndex])
+		{
+			return LayerIndex;
+		}
+	}
+	return Layers.Num() - 1;
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::AddToGrid(const FGridActor& GridActor)
+{
+	UReplicationGraphNode_GridLayer* Layer = Layers[GridActor.LayerIndex];
+	switch (GridActor.Path)
+	{
+	case EGridPath::Static:		Layer->AddActor_Static(GridActor.ActorInfo, *GridActor.GlobalInfo); break;
+	case EGridPath::Dynamic:	Layer->AddActor_Dynamic(GridActor.ActorInfo, *GridActor.GlobalInfo); break;
+	case EGridPath::Dormancy:	Layer->AddActor_Dormancy(GridActor.ActorInfo, *GridActor.GlobalInfo); break;
+	}
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::RemoveFromGrid(const FGridActor& GridActor)
+{
+	UReplicationGraphNode_GridLayer* Layer = Layers[GridActor.LayerIndex];
+	switch (GridActor.Path)
+	{
+	case EGridPath::Static:		Layer->RemoveActor_Static(GridActor.ActorInfo); break;
+	case EGridPath::Dynamic:	Layer->RemoveActor_Dynamic(GridActor.ActorInfo); break;
+	case EGridPath::Dormancy:	Layer->RemoveActor_Dormancy(GridActor.ActorInfo); break;
+	}
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::AddActor(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo, EGridPath Path)
+{
+	FGridActor& GridActor = GridActors.Add(ActorInfo.Actor);
+	GridActor.ActorInfo = ActorInfo;
+	GridActor.GlobalInfo = &ActorRepInfo;
+	GridActor.LayerIndex = GetLayerIndex(ActorRepInfo);
+	GridActor.Path = Path;
+	++NumActorsByPath[(int32)Path];
+
+	ActorRepInfo.WorldLocation = ActorInfo.Actor->GetActorLocation();
+	GridActor.bOutOfBounds = !IsInBounds(ActorRepInfo.WorldLocation);
+
+	if (GridActor.bOutOfBounds)
+	{
+		OutOfBoundsActors.Add(ActorInfo.Actor);
+		OverflowNode->NotifyAddNetworkActor(ActorInfo);
+	}
+	else
+	{
+		AddToGrid(GridActor);
+	}
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::AddActor_Static(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo)
+{
+	AddActor(ActorInfo, ActorRepInfo, EGridPath::Static);
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::AddActor_Dynamic(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo)
+{
+	AddActor(ActorInfo, ActorRepInfo, EGridPath::Dynamic);
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::AddActor_Dormancy(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo)
+{
+	AddActor(ActorInfo, ActorRepInfo, EGridPath::Dormancy);
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::AddActor_Auto(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo)
+{
+	AddActor(ActorInfo, ActorRepInfo, EGridPath::Dynamic);
+
+	FAutoPathActor& AutoPathActor = AutoPathActors.Add(ActorInfo.Actor);
+	AutoPathActor.SettledLocation = ActorRepInfo.WorldLocation;
+	AutoPathActor.LastMoveTime = FPlatformTime::Seconds();
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::RemoveActor(const FNewReplicatedActorInfo& ActorInfo)
+{
+	FGridActor GridActor;
+	if (!GridActors.RemoveAndCopyValue(ActorInfo.Actor, GridActor))
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Attempted to remove %s from %s but it was not found."), *GetActorRepListTypeDebugString(ActorInfo.Actor), *GetName());
+		return;
+	}
+	--NumActorsByPath[(int32)GridActor.Path];
+	AutoPathActors.Remove(ActorInfo.Actor);
+
+	if (GridActor.bOutOfBounds)
+	{
+		OutOfBoundsActors.Remove(ActorInfo.Actor);
+		OverflowNode->NotifyRemoveNetworkActor(ActorInfo);
+	}
+	else
+	{
+		RemoveFromGrid(GridActor);
+	}
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::NotifyAddNetworkActor(const FNewReplicatedActorInfo& Actor)
+{
+	ensureMsgf(false, TEXT("UReplicationGraphNode_GridSpatialization2D_Layered::NotifyAddNetworkActor should not be called directly"));
+}
+
+bool UReplicationGraphNode_GridSpatialization2D_Layered::NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound)
+{
+	ensureMsgf(false, TEXT("UReplicationGraphNode_GridSpatialization2D_Layered::NotifyRemoveNetworkActor should not be called directly"));
+	return false;
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::NotifyResetAllNetworkActors()
+{
+	GridActors.Reset();
+	OutOfBoundsActors.Reset();
+	FMemory::Memzero(NumActorsByPath);
+	AutoPathActors.Reset();
+	Super::NotifyResetAllNetworkActors();
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::CheckOutOfBoundsActors()
+{
+	for (auto& GridActorPair : GridActors)
+	{
+		FGridActor& GridActor = GridActorPair.Value;
+		if (GridActor.Path == EGridPath::Static)
+		{
+			continue;
+		}
+
+		const bool bOutOfBounds = !IsInBounds(GridActor.ActorInfo.Actor->GetActorLocation());
+		if (bOutOfBounds == GridActor.bOutOfBounds)
+		{
+			continue;
+		}
+
+		if (bOutOfBounds)
+		{
+			RemoveFromGrid(GridActor);
+			OutOfBoundsActors.Add(GridActor.ActorInfo.Actor);
+			OverflowNode->NotifyAddNetworkActor(GridActor.ActorInfo);
+		}
+		else
+		{
+			OutOfBoundsActors.Remove(GridActor.ActorInfo.Actor);
+			OverflowNode->NotifyRemoveNetworkActor(GridActor.ActorInfo);
+			AddToGrid(GridActor);
+		}
+		GridActor.bOutOfBounds = bOutOfBounds;
+	}
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::UpdateAutoPaths()
+{
+	const double CurrentTime = FPlatformTime::Seconds();
+	const float MoveThresholdSquared = FMath::Square(AutoPathMoveThreshold);
+	for (auto& AutoPathPair : AutoPathActors)
+	{
+		FAutoPathActor& AutoPathActor = AutoPathPair.Value;
+		FGridActor& GridActor = GridActors.FindChecked(AutoPathPair.Key);
+		const AActor* Actor = GridActor.ActorInfo.Actor;
+		const FVector Location = Actor->GetActorLocation();
+
+		if (FVector::DistSquared(Location, AutoPathActor.SettledLocation) > MoveThresholdSquared)
+		{
+			//promote on first move, static cells would keep it where it settled
+			AutoPathActor.SettledLocation = Location;
+			AutoPathActor.LastMoveTime = CurrentTime;
+			if (GridActor.Path != EGridPath::Dynamic)
+			{
+				SetPath(GridActor, EGridPath::Dynamic);
+			}
+		}
+		else if (GridActor.Path == EGridPath::Dynamic && CurrentTime - AutoPathActor.LastMoveTime >= AutoPathStillTime)
+		{
+			//dormancy path goes dynamic by itself while actor is awake
+			SetPath(GridActor, Actor->NetDormancy > DORM_Awake ? EGridPath::Dormancy : EGridPath::Static);
+		}
+	}
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::SetPath(FGridActor& GridActor, EGridPath Path)
+{
+	//removal finds static cells from location they were added at, so location is updated after it
+	if (!GridActor.bOutOfBounds)
+	{
+		RemoveFromGrid(GridActor);
+	}
+
+	--NumActorsByPath[(int32)GridActor.Path];
+	++NumActorsByPath[(int32)Path];
+	++NumAutoPathChanges;
+	GridActor.Path = Path;
+	GridActor.GlobalInfo->WorldLocation = GridActor.ActorInfo.Actor->GetActorLocation();
+
+	//out of bounds actors stay in overflow, bounds check moves them to grid once they are dynamic again
+	if (!GridActor.bOutOfBounds)
+	{
+		AddToGrid(GridActor);
+	}
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::PrepareForReplication()
+{
+	//before layers prepare, so promoted actors get their cells this frame
+	NumAutoPathChanges = 0;
+	if (AutoPathActors.Num() > 0)
+	{
+		UpdateAutoPaths();
+	}
+
+	if (SpatialBounds.bIsValid)
+	{
+		const double CurrentTime = FPlatformTime::Seconds();
+		if (CurrentTime >= NextOutOfBoundsCheckTime)
+		{
+			NextOutOfBoundsCheckTime = CurrentTime + OutOfBoundsCheckInterval;
+			CheckOutOfBoundsActors();
+		}
+	}
+
+	for (UReplicationGraphNode_GridLayer* Layer : Layers)
+	{
+		Layer->PrepareForReplication();
+	}
+
+	//grid updates locations of it's own actors, overflow actors need it for distance culling
+	for (FActorRepListType Actor : OutOfBoundsActors)
+	{
+		FGridActor& GridActor = GridActors.FindChecked(Actor);
+		if (GridActor.Path != EGridPath::Static)
+		{
+			GridActor.GlobalInfo->WorldLocation = Actor->GetActorLocation();
+		}
+	}
+
+	SET_DWORD_STAT(STAT_LocusRepGraph_OutOfBoundsActors, OutOfBoundsActors.Num());
+	SET_DWORD_STAT(STAT_LocusRepGraph_GridStaticActors, NumActorsByPath[(int32)EGridPath::Static]);
+	SET_DWORD_STAT(STAT_LocusRepGraph_GridDynamicActors, NumActorsByPath[(int32)EGridPath::Dynamic]);
+	SET_DWORD_STAT(STAT_LocusRepGraph_GridDormancyActors, NumActorsByPath[(int32)EGridPath::Dormancy]);
+	SET_DWORD_STAT(STAT_LocusRepGraph_GridAutoPathChanges, NumAutoPathChanges);
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	LOCUS_SCOPE_GATHER_STAT(Grid, Params);
+	const FLocusScopedFollowGather FollowGather(Params, true);
+	if (FollowGather.ShouldSkip())
+	{
+		return;
+	}
+
+	for (UReplicationGraphNode_GridLayer* Layer : Layers)
+	{
+		Layer->GatherActorListsForConnection(Params);
+	}
+
+	if (OutOfBoundsActors.Num() > 0)
+	{
+		OverflowNode->GatherActorListsForConnection(Params);
+	}
+}
+
+void UReplicationGraphNode_GridSpatialization2D_Layered::GetAllActorsInNode_Debugging(TArray<FActorRepListType>& OutArray) const
+{
+	for (UReplicationGraphNode_GridLayer* Layer : Layers)
+	{
+		Layer->GetAllActorsInNode_Debugging(OutArray);
+	}
+	OverflowNode->GetAllActorsInNode_Debugging(OutArray);
+}
+
+UReplicationGraphNode_VoxelSpatialization3D::UReplicationGraphNode_VoxelSpatialization3D()
+{
+	bRequiresPrepareForReplicationCall = true;
+}
+
+FIntVector UReplicationGraphNode_VoxelSpatialization3D::GetCellCoord(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / VerticalCellSize));
+}
+
+UReplicationGraphNode_ActorList* UReplicationGraphNode_VoxelSpatialization3D::GetCell(const FIntVector& Coord) const
+{
+	const FVoxelCell* Cell = Cells.Find(Coord);
+	return Cell ? Cell->Node : nullptr;
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::AddToCell(const FIntVector& Coord, const FNewReplicatedActorInfo& ActorInfo)
+{
+	FVoxelCell& Cell = Cells.FindOrAdd(Coord);
+	if (!Cell.Node)
+	{
+		Cell.Node = FreeCells.Num() > 0 ? FreeCells.Pop(false) : CreateChildNode<UReplicationGraphNode_ActorList>();
+	}
+	Cell.Node->NotifyAddNetworkActor(ActorInfo);
+	++Cell.NumActors;
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::RemoveFromCell(const FIntVector& Coord, const FNewReplicatedActorInfo& ActorInfo)
+{
+	FVoxelCell* Cell = Cells.Find(Coord);
+	if (Cell && Cell->Node->NotifyRemoveNetworkActor(ActorInfo, false) && --Cell->NumActors <= 0)
+	{
+		//empty voxels would pile up along every path actors ever took
+		FreeCells.Add(Cell->Node);
+		Cells.Remove(Coord);
+	}
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::AddToCells(const FVoxelActor& VoxelActor)
+{
+	for (int32 X = -VoxelActor.Extent.X; X <= VoxelActor.Extent.X; ++X)
+	{
+		for (int32 Y = -VoxelActor.Extent.Y; Y <= VoxelActor.Extent.Y; ++Y)
+		{
+			for (int32 Z = -VoxelActor.Extent.Z; Z <= VoxelActor.Extent.Z; ++Z)
+			{
+				AddToCell(VoxelActor.Cell + FIntVector(X, Y, Z), VoxelActor.ActorInfo);
+			}
+		}
+	}
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::RemoveFromCells(const FVoxelActor& VoxelActor)
+{
+	for (int32 X = -VoxelActor.Extent.X; X <= VoxelActor.Extent.X; ++X)
+	{
+		for (int32 Y = -VoxelActor.Extent.Y; Y <= VoxelActor.Extent.Y; ++Y)
+		{
+			for (int32 Z = -VoxelActor.Extent.Z; Z <= VoxelActor.Extent.Z; ++Z)
+			{
+				RemoveFromCell(VoxelActor.Cell + FIntVector(X, Y, Z), VoxelActor.ActorInfo);
+			}
+		}
+	}
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::MoveCells(FVoxelActor& VoxelActor, const FIntVector& NewCell)
+{
+	const FIntVector& Extent = VoxelActor.Extent;
+	auto IsCovered = [&Extent](const FIntVector& Center, const FIntVector& Coord)
+	{
+		return FMath::Abs(Coord.X - Center.X) <= Extent.X && FMath::Abs(Coord.Y - Center.Y) <= Extent.Y && FMath::Abs(Coord.Z - Center.Z) <= Extent.Z;
+	};
+
+	//same extent around both cells, so a voxel covered by one side only enters or leaves
+	const FIntVector OldCell = VoxelActor.Cell;
+	for (int32 X = -Extent.X; X <= Extent.X; ++X)
+	{
+		for (int32 Y = -Extent.Y; Y <= Extent.Y; ++Y)
+		{
+			for (int32 Z = -Extent.Z; Z <= Extent.Z; ++Z)
+			{
+				const FIntVector Offset(X, Y, Z);
+				if (!IsCovered(NewCell, OldCell + Offset))
+				{
+					RemoveFromCell(OldCell + Offset, VoxelActor.ActorInfo);
+				}
+				if (!IsCovered(OldCell, NewCell + Offset))
+				{
+					AddToCell(NewCell + Offset, VoxelActor.ActorInfo);
+				}
+			}
+		}
+	}
+	VoxelActor.Cell = NewCell;
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::AddActor(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo, float VerticalCullDistance)
+{
+	const float CullDistance = ActorRepInfo.Settings.GetCullDistance();
+	//falling back to cull distance would put a 100m actor in 31 floors of voxels
+	if (VerticalCullDistance <= 0.f)
+	{
+		VerticalCullDistance = VerticalCellSize;
+	}
+
+	FVoxelActor& VoxelActor = VoxelActors.Add(ActorInfo.Actor);
+	VoxelActor.ActorInfo = ActorInfo;
+	VoxelActor.GlobalInfo = &ActorRepInfo;
+	VoxelActor.Extent.X = VoxelActor.Extent.Y = FMath::CeilToInt(CullDistance / CellSize);
+	VoxelActor.Extent.Z = FMath::Clamp(FMath::CeilToInt(VerticalCullDistance / VerticalCellSize), 1, MaxVerticalExtent);
+
+	ActorRepInfo.WorldLocation = ActorInfo.Actor->GetActorLocation();
+	VoxelActor.Cell = GetCellCoord(ActorRepInfo.WorldLocation);
+	AddToCells(VoxelActor);
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::RemoveActor(const FNewReplicatedActorInfo& ActorInfo)
+{
+	FVoxelActor VoxelActor;
+	if (!VoxelActors.RemoveAndCopyValue(ActorInfo.Actor, VoxelActor))
+	{
+		UE_LOG(LogLocusReplicationGraph, Warning, TEXT("Attempted to remove %s from %s but it was not found."), *GetActorRepListTypeDebugString(ActorInfo.Actor), *GetName());
+		return;
+	}
+
+	RemoveFromCells(VoxelActor);
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::NotifyAddNetworkActor(const FNewReplicatedActorInfo& Actor)
+{
+	ensureMsgf(false, TEXT("UReplicationGraphNode_VoxelSpatialization3D::NotifyAddNetworkActor should not be called directly"));
+}
+
+bool UReplicationGraphNode_VoxelSpatialization3D::NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound)
+{
+	ensureMsgf(false, TEXT("UReplicationGraphNode_VoxelSpatialization3D::NotifyRemoveNetworkActor should not be called directly"));
+	return false;
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::NotifyResetAllNetworkActors()
+{
+	VoxelActors.Reset();
+	Super::NotifyResetAllNetworkActors();
+
+	for (const auto& CellPair : Cells)
+	{
+		FreeCells.Add(CellPair.Value.Node);
+	}
+	Cells.Reset();
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::PrepareForReplication()
+{
+	//rebin actors that crossed a voxel boundary
+	for (auto& VoxelActorPair : VoxelActors)
+	{
+		FVoxelActor& VoxelActor = VoxelActorPair.Value;
+		VoxelActor.GlobalInfo->WorldLocation = VoxelActor.ActorInfo.Actor->GetActorLocation();
+
+		const FIntVector NewCell = GetCellCoord(VoxelActor.GlobalInfo->WorldLocation);
+		if (NewCell != VoxelActor.Cell)
+		{
+			MoveCells(VoxelActor, NewCell);
+		}
+	}
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	LOCUS_SCOPE_GATHER_STAT(Voxel, Params);
+	const FLocusScopedFollowGather FollowGather(Params, true);
+	if (FollowGather.ShouldSkip())
+	{
+		return;
+	}
+
+	TArray<UReplicationGraphNode_ActorList*, TInlineAllocator<4>> GatheredCells;
+	for (const FNetViewer& Viewer : Params.Viewers)
+	{
+		UReplicationGraphNode_ActorList* Cell = GetCell(GetCellCoord(Viewer.ViewLocation));
+		if (Cell && !GatheredCells.Contains(Cell))
+		{
+			GatheredCells.Add(Cell);
+			Cell->GatherActorListsForConnection(Params);
+		}
+	}
+}
+
+void UReplicationGraphNode_VoxelSpatialization3D::GetAllActorsInNode_Debugging(TArray<FActorRepListType>& OutArray) const
+{
+	for (const auto& VoxelActorPair : VoxelActors)
+	{
+		OutArray.Add(VoxelActorPair.Key);
+	}
+}
+
+void FLocusCellGrid::Init(const FBox2D& Bounds, float InCellSize)
+{
+	CellSize = InCellSize;
+	Origin = Bounds.Min;
+
+	const FVector2D Size = Bounds.GetSize();
+	NumX = FMath::Max(FMath::CeilToInt(Size.X / CellSize), 1);
+	NumY = FMath::Max(FMath::CeilToInt(Size.Y / CellSize), 1);
+}
+
+UReplicationGraphNode_TeamVision::UReplicationGraphNode_TeamVision()
+{
+	bRequiresPrepareForReplicationCall = true;
+}
+
+void UReplicationGraphNode_TeamVision::InitGrid(const FBox2D& Bounds, float CellSize)
+{
+	for (UReplicationGraphNode_ActorList*& Cell : Cells)
+	{
+		if (Cell)
+		{
+			Cell->NotifyResetAllNetworkActors();
+			FreeCells.Add(Cell);
+			Cell = nullptr;
+		}
+	}
+
+	Grid.Init(Bounds, CellSize);
+	Cells.SetNumZeroed(Grid.Num());
+
+	for (auto& TeamVisionPair : TeamVisions)
+	{
+		FTeamVision& TeamVision = TeamVisionPair.Value;
+		TeamVision.RefCounts.Reset();
+		TeamVision.RefCounts.SetNumZeroed(Grid.Num());
+		TeamVision.VisibleCells.Reset();
+		TeamVision.VisibleCellSlots.Init(INDEX_NONE, Grid.Num());
+	}
+
+	for (auto& VisionActorPair : VisionActors)
+	{
+		FVisionActor& VisionActor = VisionActorPair.Value;
+		VisionActor.CellIndex = Grid.GetIndex(VisionActor.ActorInfo.Actor->GetActorLocation());
+		GetOrCreateCell(VisionActor.CellIndex)->NotifyAddNetworkActor(VisionActor.ActorInfo);
+	}
+
+	//footprints are applied again at next PrepareForReplication
+	for (auto& VisionSourcePair : VisionSources)
+	{
+		VisionSourcePair.Value.CellIndex = INDEX_NONE;
+	}
+}
+
+UReplicationGraphNode_TeamVision::FTeamVision& UReplicationGraphNode_TeamVision::FindOrAddTeamVision(FName TeamName)
+{
+	if (FTeamVision* TeamVision = TeamVisions.Find(TeamName))
+	{
+		return *TeamVision;
+	}
+
+	FTeamVision& TeamVision = TeamVisions.Add(TeamName);
+	TeamVision.RefCounts.SetNumZeroed(Grid.Num());
+	TeamVision.VisibleCellSlots.Init(INDEX_NONE, Grid.Num());
+	return TeamVision;
+}
+
+UReplicationGraphNode_ActorList* UReplicationGraphNode_TeamVision::GetOrCreateCell(int32 CellIndex)
+{
+	UReplicationGraphNode_ActorList*& Cell = Cells[CellIndex];
+	if (!Cell)
+	{
+		Cell = FreeCells.Num() > 0 ? FreeCells.Pop(false) : CreateChildNode<UReplicationGraphNode_ActorList>();
+	}
+	return Cell;
+}
+
+void UReplicationGraphNode_TeamVision::UpdateFootprint(const FVisionSource& Source, int32 Delta)
+{
+	if (Source.CellIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	FTeamVision& TeamVision = FindOrAddTeamVision(Source.TeamName);
+	Grid.ForEachCellInRadius(Source.CellIndex, Source.Radius, [&](int32 CellIndex)
+	{
+		uint16& RefCount = TeamVision.RefCounts[CellIndex];
+		if (Delta > 0)
+		{
+			if (RefCount++ == 0)
+			{
+				TeamVision.VisibleCellSlots[CellIndex] = TeamVision.VisibleCells.Add(CellIndex);
+			}
+		}
+		else if (RefCount > 0 && --RefCount == 0)
+		{
+			const int32 Slot = TeamVision.VisibleCellSlots[CellIndex];
+			TeamVision.VisibleCells.RemoveAtSwap(Slot, 1, false);
+			if (TeamVision.VisibleCells.IsValidIndex(Slot))
+			{
+				TeamVision.VisibleCellSlots[TeamVision.VisibleCells[Slot]] = Slot;
+			}
+			TeamVision.VisibleCellSlots[CellIndex] = INDEX_NONE;
+		}
+	});
+}
+
+void UReplicationGraphNode_TeamVision::AddVisionSource(AActor* Source, FName TeamName, float Radius)
+{
+	if (!Source)
+	{
+		return;
+	}
+
+	FVisionSource& VisionSource = VisionSources.FindOrAdd(Source);
+	UpdateFootprint(VisionSource, -1);
+	VisionSource.TeamName = TeamName;
+	VisionSource.Radius = Radius;
+	VisionSource.CellIndex = INDEX_NONE;
+}
+
+void UReplicationGraphNode_TeamVision::RemoveVisionSource(AActor* Source)
+{
+	FVisionSource VisionSource;
+	if (VisionSources.RemoveAndCopyValue(Source, VisionSource))
+	{
+		UpdateFootprint(VisionSource, -1);
+	}
+}
+
+bool UReplicationGraphNode_TeamVision::IsVisibleToTeam(FName TeamName, const FVector& Location) const
+{
+	const FTeamVision* TeamVision = TeamVisions.Find(TeamName);
+	return TeamVision && Grid.IsValid() && TeamVision->RefCounts[Grid.GetIndex(Location)] > 0;
+}
+
+void UReplicationGraphNode_TeamVision::NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo)
+{
+	FVisionActor& VisionActor = VisionActors.Add(ActorInfo.Actor);
+	VisionActor.ActorInfo = ActorInfo;
+	VisionActor.GlobalInfo = &GraphGlobals->GlobalActorReplicationInfoMap->Get(ActorInfo.Actor);
+
+	if (Grid.IsValid())
+	{
+		VisionActor.GlobalInfo->WorldLocation = ActorInfo.Actor->GetActorLocation();
+		VisionActor.CellIndex = Grid.GetIndex(VisionActor.GlobalInfo->WorldLocation);
+		GetOrCreateCell(VisionActor.CellIndex)->NotifyAddNetworkActor(ActorInfo);
+	}
+}
+
+bool UReplicationGraphNode_TeamVision::NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound)
+{
+	FVisionActor VisionActor;
+	if (!VisionActors.RemoveAndCopyValue(ActorInfo.Actor, VisionActor))
+	{
+		UE_CLOG(bWarnIfNotFound, LogLocusReplicationGraph, Warning, TEXT("Attempted to remove %s from TeamVision node %s but it was not found."), *GetActorRepListTypeDebugString(ActorInfo.Actor), *GetName());
+		return false;
+	}
+
+	if (VisionActor.CellIndex != INDEX_NONE)
+	{
+		Cells[VisionActor.CellIndex]->NotifyRemoveNetworkActor(ActorInfo);
+	}
+	return true;
+}
+
+void UReplicationGraphNode_TeamVision::NotifyResetAllNetworkActors()
+{
+	VisionActors.Reset();
+	VisionSources.Reset();
+	TeamVisions.Reset();
+	Super::NotifyResetAllNetworkActors();
+}
+
+void UReplicationGraphNode_TeamVision::PrepareForReplication()
+{
+	if (!Grid.IsValid())
+	{
+		return;
+	}
+
+	//only sources that crossed a cell touch refcounts
+	for (auto It = VisionSources.CreateIterator(); It; ++It)
+	{
+		FVisionSource& VisionSource = It.Value();
+		AActor* Source = It.Key().Get();
+		if (!Source)
+		{
+			UpdateFootprint(VisionSource, -1);
+			It.RemoveCurrent();
+			continue;
+		}
+
+		const int32 CellIndex = Grid.GetIndex(Source->GetActorLocation());
+		if (CellIndex != VisionSource.CellIndex)
+		{
+			UpdateFootprint(VisionSource, -1);
+			VisionSource.CellIndex = CellIndex;
+			UpdateFootprint(VisionSource, 1);
+		}
+	}
+
+	for (auto& VisionActorPair : VisionActors)
+	{
+		FVisionActor& VisionActor = VisionActorPair.Value;
+		VisionActor.GlobalInfo->WorldLocation = VisionActor.ActorInfo.Actor->GetActorLocation();
+
+		const int32 CellIndex = Grid.GetIndex(VisionActor.GlobalInfo->WorldLocation);
+		if (CellIndex != VisionActor.CellIndex)
+		{
+			if (VisionActor.CellIndex != INDEX_NONE)
+			{
+				Cells[VisionActor.CellIndex]->NotifyRemoveNetworkActor(VisionActor.ActorInfo);
+			}
+			VisionActor.CellIndex = CellIndex;
+			GetOrCreateCell(CellIndex)->NotifyAddNetworkActor(VisionActor.ActorInfo);
+		}
+	}
+}
+
+void UReplicationGraphNode_TeamVision::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	LOCUS_SCOPE_GATHER_STAT(TeamVision, Params);
+	const FLocusScopedFollowGather FollowGather(Params, true);
+	if (FollowGather.ShouldSkip())
+	{
+		return;
+	}
+
+	ULocusReplicationConnectionGraph* LocusConnManager = Cast<ULocusReplicationConnectionGraph>(&Params.ConnectionManager);
+	const FName TeamName = LocusConnManager ? LocusConnManager->TeamName : NAME_None;
+	if (TeamName == NAME_None)
+	{
+		return;
+	}
+
+	if (const FTeamVision* TeamVision = TeamVisions.Find(TeamName))
+	{
+		for (int32 CellIndex : TeamVision->VisibleCells)
+		{
+			if (UReplicationGraphNode_ActorList* Cell = Cells[CellIndex])
+			{
+				Cell->GatherActorListsForConnection(Params);
+			}
+		}
+	}
+}
+
+void UReplicationGraphNode_TeamVision::GetAllActorsInNode_Debugging(TArray<FActorRepListType>& OutArray) const
+{
+	for (const auto& VisionActorPair : VisionActors)
+	{
+		OutArray.Add(VisionActorPair.Key);
+	}
+}
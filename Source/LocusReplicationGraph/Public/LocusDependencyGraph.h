@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+#include "CoreMinimal.h"
+
+class AActor;
+
+/**
+ * Transitive replication dependencies between actors.
+ * Edge changes are queued and applied once per frame, then every replicator gets all of it's descendants
+ * flattened into it's dependent list, so a chain like vehicle -> passenger -> weapon -> attachment needs no manual wiring.
+ * Only networked actors(added to graph, even with NotRouted policy) get edges, so RemoveActor drops every actor before it goes away.
+ */
+struct LOCUSREPLICATIONGRAPH_API FLocusDependencyGraph
+{
+public:
+	//called with flattened dependent list changes of a replicator. bAdd false means removal
+	typedef TFunctionRef<void(AActor* Replicator, AActor* Dependent, bool bAdd)> FApplyDependencyFunc;
+	//whether actor is networked(has replication info)
+	typedef TFunctionRef<bool(AActor* Actor)> FIsNetworkedFunc;
+
+	void QueueAdd(AActor* Replicator, AActor* Dependent);
+	void QueueRemove(AActor* Replicator, AActor* Dependent);
+	void QueueRemoveAll(AActor* Replicator);
+
+	bool HasPendingChanges() const { return PendingOps.Num() > 0; }
+
+	//apply queued edge changes and re-flatten affected replicators. cyclic edges and edges with an actor not networked are rejected
+	void ApplyPendingChanges(FIsNetworkedFunc IsNetworked, FApplyDependencyFunc Apply);
+
+	//drop actor and all it's edges right away, ancestors lose it and it's descendants
+	void RemoveActor(AActor* Actor, FApplyDependencyFunc Apply);
+
+	void GetDependents(AActor* Replicator, TArray<AActor*>& OutDependents, bool bTransitive) const;
+
+	int32 NumReplicators() const { return Children.Num(); }
+
+	void Reset();
+
+private:
+	enum class EOpType : uint8
+	{
+		Add,
+		Remove,
+		RemoveAll,
+	};
+
+	struct FPendingOp
+	{
+		TWeakObjectPtr<AActor> Replicator;
+		TWeakObjectPtr<AActor> Dependent;
+		EOpType Type;
+	};
+
+	bool IsReachable(AActor* From, AActor* To) const;
+	void CollectAncestors(AActor* Actor, TSet<AActor*>& OutAncestors) const;
+	void CollectDescendants(AActor* Actor, TSet<AActor*>& OutDescendants) const;
+	void RemoveEdge(AActor* Replicator, AActor* Dependent);
+
+	//diff descendants of replicator against applied list
+	void Flatten(AActor* Replicator, FApplyDependencyFunc Apply);
+
+	//direct edges both ways
+	TMap<AActor*, TSet<AActor*>> Children;
+	TMap<AActor*, TSet<AActor*>> Parents;
+
+	//descendants currently applied to replicator's dependent list
+	TMap<AActor*, TSet<AActor*>> Flattened;
+
+	TArray<FPendingOp> PendingOps;
+};
@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "LocusSpatialNodes.h"
+#include "LocusPVS.generated.h"
+
+/**
+ * Baked cell to cell potentially visible set of a map.
+ * Every cell has a bitset row over the window of cells within RadiusCells around it, cells outside of the window are never visible.
+ * The file is memory-mapped, so only rows of cells that are actually viewed from get paged in.
+ */
+struct LOCUSREPLICATIONGRAPH_API FLocusPVSTable
+{
+public:
+	//file layout: header followed by NumX * NumY rows of WordsPerRow words. native endian
+	struct FHeader
+	{
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		float OriginX = 0.f;
+		float OriginY = 0.f;
+		float CellSize = 0.f;
+		int32 NumX = 0;
+		int32 NumY = 0;
+		int32 RadiusCells = 0;
+		int32 WordsPerRow = 0;
+	};
+
+	static const uint32 FileMagic = 0x5356504C; //LPVS
+	static const uint32 FileVersion = 1;
+
+	static int32 GetWordsPerRow(int32 RadiusCells) { return FMath::DivideAndRoundUp(FMath::Square(RadiusCells * 2 + 1), 32); }
+
+	//bit of cell Other in row of cell Center, INDEX_NONE if Other is outside of window
+	static int32 GetWindowBit(const FIntPoint& Center, const FIntPoint& Other, int32 RadiusCells);
+
+	//write a table, Rows holds GetWordsPerRow(RadiusCells) words for every cell of Grid
+	static bool Save(const FString& Filename, const FLocusCellGrid& Grid, int32 RadiusCells, const TArray<uint32>& Rows);
+
+	//map a table file, falls back to reading it when the platform can't map it
+	bool Load(const FString& Filename);
+	void Reset();
+
+	bool IsValid() const { return Rows != nullptr; }
+	const FLocusCellGrid& GetGrid() const { return Grid; }
+	int32 GetRadiusCells() const { return RadiusCells; }
+
+	bool IsVisible(int32 FromCell, int32 ToCell) const;
+
+	//calls Func with index of every cell visible from CellIndex, CellIndex itself included
+	template<typename FuncType>
+	void ForEachVisibleCell(int32 CellIndex, FuncType Func) const
+	{
+		const FIntPoint Center = Grid.GetCoord(CellIndex);
+		const int32 WindowSize = RadiusCells * 2 + 1;
+		const uint32* Row = Rows + (int64)CellIndex * WordsPerRow;
+		for (int32 Word = 0; Word < WordsPerRow; ++Word)
+		{
+			uint32 Bits = Row[Word];
+			while (Bits)
+			{
+				const int32 Bit = Word * 32 + FMath::CountTrailingZeros(Bits);
+				Bits &= Bits - 1;
+
+				const int32 X = Center.X + Bit % WindowSize - RadiusCells;
+				const int32 Y = Center.Y + Bit / WindowSize - RadiusCells;
+				if (X >= 0 && X < Grid.NumX && Y >= 0 && Y < Grid.NumY)
+				{
+					Func(Grid.GetIndex(FIntPoint(X, Y)));
+				}
+			}
+		}
+	}
+
+private:
+	bool InitFromData(const uint8* Data, int64 Size, const FString& Filename);
+
+	FLocusCellGrid Grid;
+	int32 RadiusCells = 0;
+	int32 WordsPerRow = 0;
+	const uint32* Rows = nullptr;
+
+	//declared after the handle, so the region is released first
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	//whole file, only when mapping is not supported
+	TArray<uint8> LoadedData;
+};
+
+/**
+ * Occlusion aware spatialization. Actors are binned into cells of a baked PVS table and viewers gather only cells visible from their own cell.
+ * Cull distance still applies per actor, the table only drops cells that are hidden behind level geometry.
+ */
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_PVS : public UReplicationGraphNode
+{
+	GENERATED_BODY()
+
+public:
+	UReplicationGraphNode_PVS();
+
+	//load table of a map, existing actors are binned again. false when there is no valid table
+	bool LoadTable(const FString& Filename);
+
+	bool HasTable() const { return Table.IsValid(); }
+	const FLocusPVSTable& GetTable() const { return Table; }
+
+	virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override;
+	virtual void NotifyResetAllNetworkActors() override;
+	virtual void PrepareForReplication() override;
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+	virtual void GetAllActorsInNode_Debugging(TArray<FActorRepListType>& OutArray) const override;
+
+protected:
+	struct FPVSActor
+	{
+		FNewReplicatedActorInfo ActorInfo;
+		FGlobalActorReplicationInfo* GlobalInfo = nullptr;
+		int32 CellIndex = INDEX_NONE;
+	};
+
+	UReplicationGraphNode_ActorList* GetOrCreateCell(int32 CellIndex);
+
+	FLocusPVSTable Table;
+
+	//dense cell lists over table grid, created when first actor enters
+	TArray<UReplicationGraphNode_ActorList*> Cells;
+	//cell nodes freed by LoadTable, reused before creating new ones
+	TArray<UReplicationGraphNode_ActorList*> FreeCells;
+
+	TMap<FActorRepListType, FPVSActor> PVSActors;
+
+	//cells seen by several viewers of a connection are gathered once
+	TArray<uint32> CellGatherStamps;
+	uint32 GatherStamp = 0;
+};
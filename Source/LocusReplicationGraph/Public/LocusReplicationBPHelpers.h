@@ -24,9 +24,43 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Network")
 	static void RemoveDependentActor(AActor* ReplicatorActor, AActor* DependentActor);
 
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	static void AddDependentActors(AActor* ReplicatorActor, const TArray<AActor*>& DependentActors);
+
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	static void RemoveDependentActors(AActor* ReplicatorActor, const TArray<AActor*>& DependentActors);
+
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	static void RemoveAllDependentActors(AActor* ReplicatorActor);
+
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	static void AddVisionSource(AActor* Source, FName TeamName, float Radius);
+
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	static void RemoveVisionSource(AActor* Source);
+
+	//Follower(spectator, caster) receives what Target's spatial and team gathers returned, in place of it's own spatial gathers. None Target stops following
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	static void SetViewFollowTarget(APlayerController* Follower, APlayerController* Target);
+
 	UFUNCTION(BlueprintCallable, Category = "Network")
 	static void ChangeOwnerAndRefreshReplication(AActor* ActorToChange, AActor* NewOwner);
 
+	//Actor uses CullDistance instead of it's class cull distance. Cleared when Actor is destroyed
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	static void SetActorCullDistanceOverride(AActor* Actor, float CullDistance);
+
+	//Actor replicates once every ReplicationPeriodFrame server frames instead of it's class period
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	static void SetActorReplicationPeriodOverride(AActor* Actor, int32 ReplicationPeriodFrame);
+
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	static void SetActorPriorityScaleOverride(AActor* Actor, float DistancePriorityScale = 1.f, float StarvationPriorityScale = 1.f);
+
+	//Actor goes back to it's class replication info
+	UFUNCTION(BlueprintCallable, Category = "Network")
+	static void ClearActorReplicationOverrides(AActor* Actor);
+
 	UFUNCTION(BlueprintCallable, meta = (WorldContext = "WorldContextObject", Category = "Network"))
 	static class ULocusReplicationGraph* FindLocusReplicationGraph(const UObject* WorldContextObject);
 };
@@ -0,0 +1,166 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Engine/NetDriver.h"
+#include "UObject/GCObject.h"
+#include "Dom/JsonObject.h"
+#include "LocusReplicationStats.h"
+#include "LocusReplicationBenchmark.generated.h"
+
+class APlayerController;
+class ULocusReplicationGraph;
+class USimulatedClientNetConnection;
+
+//Replicated actor with a movable root, base of benchmark actor classes. Each subclass gets it's own routing policy
+UCLASS(NotBlueprintable, NotPlaceable, HideDropdown)
+class LOCUSREPLICATIONGRAPH_API ALocusBenchmarkActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ALocusBenchmarkActor();
+};
+
+//Spatialize_Dynamic
+UCLASS(NotBlueprintable, NotPlaceable, HideDropdown)
+class LOCUSREPLICATIONGRAPH_API ALocusBenchmarkSpatializedActor : public ALocusBenchmarkActor
+{
+	GENERATED_BODY()
+};
+
+//RelevantOwnerConnection
+UCLASS(NotBlueprintable, NotPlaceable, HideDropdown)
+class LOCUSREPLICATIONGRAPH_API ALocusBenchmarkOwnerActor : public ALocusBenchmarkActor
+{
+	GENERATED_BODY()
+};
+
+//RelevantTeamConnection
+UCLASS(NotBlueprintable, NotPlaceable, HideDropdown)
+class LOCUSREPLICATIONGRAPH_API ALocusBenchmarkTeamActor : public ALocusBenchmarkActor
+{
+	GENERATED_BODY()
+};
+
+//NotRouted, replicated only as dependent of a spatialized actor
+UCLASS(NotBlueprintable, NotPlaceable, HideDropdown)
+class LOCUSREPLICATIONGRAPH_API ALocusBenchmarkDependentActor : public ALocusBenchmarkActor
+{
+	GENERATED_BODY()
+};
+
+//Net driver without sockets. Connections are USimulatedClientNetConnection, which drop every packet they send
+UCLASS(Transient, Config = Engine)
+class LOCUSREPLICATIONGRAPH_API ULocusBenchmarkNetDriver : public UNetDriver
+{
+	GENERATED_BODY()
+
+public:
+	ULocusBenchmarkNetDriver();
+
+	virtual bool IsAvailable() const override { return true; }
+	virtual bool InitConnect(FNetworkNotify* InNotify, const FURL& ConnectURL, FString& Error) override;
+	virtual bool InitListen(FNetworkNotify* InNotify, FURL& LocalURL, bool bReuseAddressAndPort, FString& Error) override;
+	virtual ISocketSubsystem* GetSocketSubsystem() override { return nullptr; }
+	virtual FString LowLevelGetNetworkNumber() override { return TEXT("LocusBenchmark"); }
+	virtual bool IsNetResourceValid() override { return true; }
+};
+
+struct LOCUSREPLICATIONGRAPH_API FLocusBenchmarkSettings
+{
+	//graph to benchmark, ULocusReplicationGraph if null. benchmark actor policies are added to it's settings
+	UClass* GraphClass = nullptr;
+
+	int32 NumConnections = 100;
+	//connections are spread over teams, 0 leaves them without team
+	int32 NumTeams = 4;
+	int32 NumSpatializedActors = 5000;
+	int32 NumOwnerActorsPerConnection = 4;
+	int32 NumTeamActorsPerConnection = 2;
+	//each attached to a random spatialized actor
+	int32 NumDependentActors = 500;
+
+	int32 NumFrames = 300;
+	//spatialized actors destroyed and spawned again every frame
+	int32 ChurnPerFrame = 10;
+	//connections removed in a single frame after the run
+	int32 NumDisconnects = 20;
+
+	//actors and viewers wander inside a square of this half size
+	float WorldExtent = 100000.f;
+	//spatial bounds of the graph, square of WorldExtent if invalid
+	FBox2D SpatialBounds = FBox2D(ForceInit);
+	float MoveSpeed = 600.f;
+	float DeltaSeconds = 1.f / 30.f;
+	int32 RandomSeed = 1;
+};
+
+/**
+ * Headless LocusReplicationGraph on a socketless net driver with simulated client connections.
+ * Spawns a configurable population, drives replication frames and collects per phase timings and memory as JSON.
+ * Actor and connection helpers are public so other drivers(trace replay) can feed their own inputs.
+ */
+class LOCUSREPLICATIONGRAPH_API FLocusReplicationBenchmark : public FGCObject
+{
+public:
+	FLocusReplicationBenchmark();
+	virtual ~FLocusReplicationBenchmark();
+
+	//create world, net driver and graph. false if anything failed
+	bool Init(const FLocusBenchmarkSettings& InSettings);
+	void Shutdown();
+
+	//spawn population of settings, run frames and disconnect burst
+	void Run();
+
+	APlayerController* AddConnection(const FVector& Location);
+	void RemoveConnection(APlayerController* PlayerController);
+	AActor* SpawnActor(UClass* Class, const FVector& Location, AActor* Owner = nullptr);
+	void DestroyActor(AActor* Actor);
+
+	//replicate one frame and record it's timings. routing done since last frame is recorded to this frame. DeltaSeconds of settings if 0
+	void ReplicateFrame(float DeltaSeconds = 0.f);
+
+	TSharedRef<FJsonObject> GetResults() const;
+
+	UWorld* GetWorld() const { return World; }
+	ULocusReplicationGraph* GetGraph() const { return Graph; }
+	const TArray<APlayerController*>& GetPlayerControllers() const { return PlayerControllers; }
+
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override { return TEXT("FLocusReplicationBenchmark"); }
+
+private:
+	void Populate();
+	void MoveActors();
+	FVector RandomLocation();
+
+	FLocusBenchmarkSettings Settings;
+	FRandomStream Random;
+
+	UWorld* World = nullptr;
+	ULocusBenchmarkNetDriver* NetDriver = nullptr;
+	ULocusReplicationGraph* Graph = nullptr;
+
+	TArray<APlayerController*> PlayerControllers;
+	TArray<AActor*> SpatializedActors;
+	TArray<AActor*> OtherActors;
+
+	//per frame, sized for the whole run
+	FLocusStatBuffer ReplicateMs;
+	FLocusStatBuffer RouteMs;
+	FLocusStatBuffer PendingMs;
+	FLocusStatBuffer GatherMs[(int32)ELocusGatherStat::Num];
+
+	double SetupMs = 0.0;
+	int32 NumSetupActors = 0;
+	double DisconnectMs = 0.0;
+	double DisconnectFrameMs = 0.0;
+	int32 NumDisconnected = 0;
+
+	uint64 UsedMemoryAtStart = 0;
+	uint64 UsedMemoryAfterSetup = 0;
+	uint64 UsedMemoryAfterRun = 0;
+};
@@ -3,6 +3,12 @@
 #pragma once
 #include "CoreMinimal.h"
 #include "ReplicationGraph.h"
+#include "UObject/ObjectKey.h"
+#include "LocusSpatialNodes.h"
+#include "LocusDependencyGraph.h"
+#include "LocusPVS.h"
+#include "LocusReplicationStats.h"
+#include "LocusReplicationTrace.h"
 #include "LocusReplicationGraph.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogLocusReplicationGraph, Display, All);
@@ -10,6 +16,7 @@ DECLARE_LOG_CATEGORY_EXTERN(LogLocusReplicationGraph, Display, All);
 //class UReplicationGraphNode_GridSpatialization2D;
 class AGameplayDebuggerCategoryReplicator;
 class ULocusReplicationConnectionGraph;
+class ULocusReplicationRoutingTable;
 
 // This is the main enum we use to route actors to the right replication node. Each class maps to one enum.
 UENUM(BlueprintType)
@@ -23,6 +30,12 @@ enum class EClassRepNodeMapping : uint8
 	RelevantOwnerConnection,			
 	// Routes to an AlwaysRelevantNode_ForTeam node
 	RelevantTeamConnection,			
+	// Routes to an OwnerSpatialized node: only owner connection see this, culled by distance from owner's viewers
+	RelevantOwnerConnection_Spatialized,
+	// Routes to owner team's spatial grid: only connections of owner's team see this, culled by grid cells like Spatialize_Dynamic
+	RelevantTeamConnection_Spatialized,
+	// Routes to TeamVisionNode: relevant to a team only while one of it's vision sources covers the actor's cell
+	RelevantTeamVision,
 
 	// ONLY SPATIALIZED Enums below here! See UReplicationGraphBase::IsSpatialized
 
@@ -32,14 +45,40 @@ enum class EClassRepNodeMapping : uint8
 	Spatialize_Dynamic,				
 	// Routes to GridNode: While dormant we treat as static. When flushed/not dormant dynamic. Note this is for things that "move while not dormant".
 	Spatialize_Dormancy,
+	// Routes to VoxelNode: moving actors on vertically layered maps, culled by voxels with separate vertical cull distance.
+	Spatialize_3D,
+	// Routes to PVSNode: cells hidden from viewer's cell by level geometry are skipped, using the baked PVS table of the map. Spatialize_Dynamic without a table.
+	Spatialize_PVS,
 };
 
 
-struct FTeamRequest
+//time a gather of node type StatName into graph's rolling stats and gathering connection's total, used inside node members
+#define LOCUS_SCOPE_GATHER_STAT(StatName, GatherParams) \
+	FLocusScopedStatCycles LocusScopedGatherCycles(CastChecked<ULocusReplicationGraph>(GraphGlobals->ReplicationGraph)->Stats.GatherCycles[(int32)ELocusGatherStat::StatName]); \
+	FLocusScopedConnectionGatherCycles LocusScopedConnectionGatherCycles(GatherParams)
+
+//Connection an owner/team relevant actor is routed to, so it's removed from the same connection after it's owner changed
+struct FRoutedOwnerActor
+{
+	TWeakObjectPtr<ULocusReplicationConnectionGraph> Connection;
+	//top net owner when routed. only compared, never dereferenced
+	const AActor* TopOwner = nullptr;
+	EClassRepNodeMapping Policy = EClassRepNodeMapping::NotRouted;
+	//position in ULocusReplicationGraph's owner check order
+	int32 CheckIndex = INDEX_NONE;
+};
+
+
+//Actors and team request waiting for an owner(usually a PlayerController) to get its connection
+struct FPendingOwnerEntry
 {
-	FName TeamName;
-	APlayerController* Requestor;
-	FTeamRequest(FName InTeamName, APlayerController* PC):TeamName(InTeamName), Requestor(PC) {}
+	//owner/team relevant actors that could not find connection when routed
+	TSet<TWeakObjectPtr<AActor>> Actors;
+	//last requested team, valid only if bHasTeamRequest
+	FName TeamName = NAME_None;
+	bool bHasTeamRequest = false;
+	//platform time when this entry was created, used for expiry
+	double PendingSince = 0.0;
 };
 
 
@@ -75,17 +114,23 @@ public:
 	// Cull distance that overrides NetCullDistance (Warning : IsNetRelevantFor will not be called in this system)
 	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.0", UIMin = "0.0"))
 	float CullDistanceSquared = 0.f;
+	// Vertical reach of Spatialize_3D actors, 0 uses one Voxel Vertical Cell Size. Capped at 4 vertical cells. Child classes inherit it unless they have their own preset
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.0", UIMin = "0.0"))
+	float VerticalCullDistance = 0.f;
 	//Server frame count per actual replication
 	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.0", UIMin = "0.0"))
 	uint8 ReplicationPeriodFrame = 1;
 	// How long will this actor channel stay alive even after it's being out of relevancy
 	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.0", UIMin = "0.0"))
 	uint8 ActorChannelFrameTimeout = 4;
+	// Low priority class: replication period is stretched for connections that are saturated
+	UPROPERTY(EditAnywhere)
+	bool AdaptiveReplicationPeriod = false;
 	// Whether this setting overrides all child classes or not
 	UPROPERTY(EditAnywhere)
 	bool IncludeChildClasses = true;
 
-	FClassReplicationInfo CreateClassReplicationInfo()
+	FClassReplicationInfo CreateClassReplicationInfo() const
 	{
 		FClassReplicationInfo Info;
 		Info.DistancePriorityScale = DistancePriorityScale;
@@ -98,19 +143,121 @@ public:
 };
 
 
-struct LOCUSREPLICATIONGRAPH_API FTeamConnectionListMap : public TMap<FName, TArray<ULocusReplicationConnectionGraph*>>
+//Slot-indexed storage of initialized connections. Slot index stays stable for connection's lifetime, freed slots are reused.
+struct LOCUSREPLICATIONGRAPH_API FLocusConnectionSlots
 {
 public:
-	//Get array of connection managers for gathering actor list
-	TArray<ULocusReplicationConnectionGraph*>* GetConnectionArrayForTeam(FName TeamName);
+	//Add Connection to free slot, returns slot index
+	int32 Add(ULocusReplicationConnectionGraph* ConnManager);
 
-	//Add Connection to team, if there's no array, add one.
-	void AddConnectionToTeam(FName TeamName, ULocusReplicationConnectionGraph* ConnManager);
+	//Free slot of Connection
+	void Remove(ULocusReplicationConnectionGraph* ConnManager);
 
-	//Remove Connection from team, if there's no member of the team after removal, remove array from the map
-	void RemoveConnectionFromTeam(FName TeamName, ULocusReplicationConnectionGraph* ConnManager);
+	//Find Connection by NetConnection, O(1)
+	ULocusReplicationConnectionGraph* Find(const UNetConnection* NetConnection) const;
+
+	void Reset();
+
+	int32 Num() const { return SlotByConnection.Num(); }
+
+private:
+	TArray<ULocusReplicationConnectionGraph*> Slots;
+	TArray<int32> FreeSlots;
+	TMap<const UNetConnection*, int32> SlotByConnection;
+};
+
+//EClassRepNodeMapping cache keyed by FObjectKey. Object indices are reused after GC but serial numbers are not, so a new class never hits a collected class's entry
+struct LOCUSREPLICATIONGRAPH_API FLocusClassPolicyTable
+{
+public:
+	//returns cached policy of class, nullptr if not cached yet
+	FORCEINLINE const EClassRepNodeMapping* Find(const UClass* Class) const
+	{
+		return Policies.Find(FObjectKey(Class));
+	}
+
+	//cache resolved policy of class
+	void Set(const UClass* Class, EClassRepNodeMapping Policy);
+
+	//free entries of garbage collected classes
+	void PurgeStale();
+
+	void Reset();
+
+	int32 Num() const { return Policies.Num(); }
+
+	//lookup counters, reported by LocusRepGraph.PolicyCacheStats
+	uint64 NumHits = 0;
+	uint64 NumMisses = 0;
+
+private:
+	TMap<FObjectKey, EClassRepNodeMapping> Policies;
+};
+
+//Replication info fields of a single actor that replace it's class values. Only fields with their flag set are applied
+struct FLocusActorReplicationOverride
+{
+	enum EField : uint8
+	{
+		CullDistance = 1 << 0,
+		ReplicationPeriod = 1 << 1,
+		PriorityScale = 1 << 2,
+	};
+
+	float CullDistanceSquared = 0.f;
+	float DistancePriorityScale = 1.f;
+	float StarvationPriorityScale = 1.f;
+	uint16 ReplicationPeriodFrame = 1;
+	uint8 Fields = 0;
+
+	//write overridden fields on top of class info
+	void ApplyTo(FClassReplicationInfo& Info) const
+	{
+		if (Fields & CullDistance)
+		{
+			Info.SetCullDistanceSquared(CullDistanceSquared);
+		}
+		if (Fields & ReplicationPeriod)
+		{
+			Info.ReplicationPeriodFrame = ReplicationPeriodFrame;
+		}
+		if (Fields & PriorityScale)
+		{
+			Info.DistancePriorityScale = DistancePriorityScale;
+			Info.StarvationPriorityScale = StarvationPriorityScale;
+		}
+	}
 };
 
+//Pooled per actor overrides. Entries live in one array and freed entries are reused, so adding and clearing overrides of short lived actors doesn't allocate.
+struct LOCUSREPLICATIONGRAPH_API FLocusActorOverrideTable
+{
+public:
+	FORCEINLINE const FLocusActorReplicationOverride* Find(const AActor* Actor) const
+	{
+		const int32* EntryIndex = EntryIndices.Num() > 0 ? EntryIndices.Find(Actor) : nullptr;
+		return EntryIndex ? &Entries[*EntryIndex] : nullptr;
+	}
+
+	FLocusActorReplicationOverride& FindOrAdd(const AActor* Actor);
+
+	//returns true if Actor had an entry
+	bool Remove(const AActor* Actor);
+
+	void Reset();
+
+	int32 Num() const { return EntryIndices.Num(); }
+	int32 GetPoolSize() const { return Entries.Num(); }
+
+	//actors with an entry
+	void GetActors(TArray<const AActor*>& OutActors) const { EntryIndices.GenerateKeyArray(OutActors); }
+
+private:
+	TArray<FLocusActorReplicationOverride> Entries;
+	TArray<int32> FreeEntries;
+	//only compared, never dereferenced
+	TMap<const AActor*, int32> EntryIndices;
+};
 
 UCLASS()
 class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_AlwaysRelevant_WithPending : public UReplicationGraphNode_ActorList
@@ -128,11 +275,89 @@ class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_AlwaysRelevant_ForTeam : p
 	GENERATED_BODY()
 
 public:
-	//Gather up other team member's list 
+	//Gather up team's shared list if connection has team, otherwise gather own list
 	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
 
-	//Function that calls parent ActorList's GatherActorList...
-	virtual void GatherActorListsForConnectionDefault(const FConnectionGatherActorListParameters& Params);
+	//Add/Remove every actor of this node to/from team shared node. used when owner connection joins/leaves a team
+	void AddAllActorsToNode(UReplicationGraphNode_ActorList* TargetNode);
+	void RemoveAllActorsFromNode(UReplicationGraphNode_ActorList* TargetNode);
+};
+
+//Team-level node owned by ULocusReplicationGraph. Holds merged actor list of all team members' team relevant actors.
+//Updated incrementally on membership/routing changes, and shared with every member connection.
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_AlwaysRelevant_TeamShared : public UReplicationGraphNode_ActorList
+{
+	GENERATED_BODY()
+
+public:
+	//connections that currently belong to this team
+	UPROPERTY()
+	TArray<ULocusReplicationConnectionGraph*> TeamMembers;
+
+	//spatial grid for team members' RelevantTeamConnection_Spatialized actors, gathered only by team members. same layers and bounds with global grid
+	UPROPERTY()
+	UReplicationGraphNode_GridSpatialization2D_Layered* TeamGridNode;
+
+	int32 NumActors() const { return ReplicationActorList.Num(); }
+};
+
+//Per connection node for actors only relevant to owner but spatialized. Culls actors by CullDistanceSquared against owner's viewers.
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_OwnerSpatialized : public UReplicationGraphNode
+{
+	GENERATED_BODY()
+
+public:
+	virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override;
+	virtual void NotifyResetAllNetworkActors() override;
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+	virtual void GetAllActorsInNode_Debugging(TArray<FActorRepListType>& OutArray) const override;
+
+	//cull actors against viewers and write result to OutActors
+	void CullActors(const FNetViewerArray& Viewers, TFunctionRef<bool(FName)> IsLevelVisible, TArray<FActorRepListType>& OutActors) const;
+
+	//cull ahead of gather from a parallel task. only touches this node, actors and visible levels must not change until gather
+	void PrecullActors(const FNetViewerArray& Viewers, const TSet<FName>& VisibleLevels, uint32 Frame);
+
+	int32 NumOwnedActors() const { return OwnedActors.Num(); }
+
+protected:
+	struct FOwnedActor
+	{
+		FActorRepListType Actor;
+		FName StreamingLevelName;
+		FGlobalActorReplicationInfo* GlobalInfo;
+	};
+
+	TArray<FOwnedActor> OwnedActors;
+
+	//culled result of this frame
+	FActorRepListRefView CulledList;
+
+	//culled actors of this frame, written by PrecullActors or first gather
+	TArray<FActorRepListType> CulledActors;
+	//replication graph frame CulledActors were culled at, so a skipped gather never leaves a stale result
+	uint32 PrecullFrame = 0;
+	bool bHasPrecull = false;
+	//CulledList holds CulledActors
+	bool bCulledListBuilt = false;
+};
+
+//Per connection node for owner's RelevantTeamConnection_Spatialized actors.
+//Gathers team's spatial grid if connection has team, otherwise culls own actors like OwnerSpatialized node.
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_TeamSpatialized : public UReplicationGraphNode_OwnerSpatialized
+{
+	GENERATED_BODY()
+
+public:
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+
+	//Add/Remove every actor of this node to/from team grid. used when owner connection joins/leaves a team
+	void AddAllActorsToGrid(UReplicationGraphNode_GridSpatialization2D_Layered* TeamGridNode);
+	void RemoveAllActorsFromGrid(UReplicationGraphNode_GridSpatialization2D_Layered* TeamGridNode);
 };
 
 //ReplicationConnectionGraph that holds team information and connection specific nodes.
@@ -148,7 +373,130 @@ public:
 	UPROPERTY()
 	class UReplicationGraphNode_AlwaysRelevant_ForTeam* TeamConnectionNode;
 
+	UPROPERTY()
+	UReplicationGraphNode_OwnerSpatialized* OwnerSpatializedNode;
+
+	UPROPERTY()
+	UReplicationGraphNode_TeamSpatialized* TeamSpatializedNode;
+
+	//shared node of the team this connection belongs to, null if it has no team
+	UPROPERTY()
+	UReplicationGraphNode_AlwaysRelevant_TeamShared* TeamSharedNode;
+
 	FName TeamName = NAME_None;
+
+	//last known PlayerController of this connection. lookup map and pending entries are updated when it changes
+	TWeakObjectPtr<APlayerController> CachedPlayerController;
+
+	//stable index in ULocusReplicationGraph's connection slots, INDEX_NONE if not initialized
+	int32 SlotIndex = INDEX_NONE;
+
+	//removed from graph and connection lists. pointers held elsewhere(routed owners, followers) must not use it
+	bool bPendingRemoval = false;
+
+	//smoothed ratio of frames this connection was not net ready, 0..1
+	float SaturationAverage = 0.f;
+
+	//multiplies ReplicationPeriodFrame of AdaptiveReplicationPeriod classes for this connection only
+	int32 ReplicationPeriodMultiplier = 1;
+
+	//platform time ReplicationPeriodMultiplier last changed or was reapplied
+	double LastPeriodMultiplierUpdateTime = 0.0;
+
+	//connection this one follows the view of, set through ULocusReplicationGraph::SetViewFollowTarget
+	TWeakObjectPtr<ULocusReplicationConnectionGraph> FollowTarget;
+
+	//connections following this one, counted once per frame. only followed connections record their gathers
+	int32 NumFollowers = 0;
+
+	//actors this connection's spatial(grid, voxel, PVS, team vision) and team gathers appended at FollowListFrame, for followers to append
+	FActorRepListRefView FollowSpatialList;
+	FActorRepListRefView FollowTeamList;
+	uint32 FollowListFrame = MAX_uint32;
+	int32 FollowGatherDepth = 0;
+
+	//actors gathered from owner, team and follow lists this frame
+	int32 GatheredActors = 0;
+	FLocusStatBuffer GatheredActorsHistory = FLocusStatBuffer(128);
+
+	//cycles spent in this graph's gathers for this connection this frame, nested gathers are counted once
+	uint64 GatherCycles = 0;
+	int32 GatherDepth = 0;
+	FLocusStatBuffer GatherMsHistory = FLocusStatBuffer(128);
+
+	//followed connection if it's still alive
+	ULocusReplicationConnectionGraph* GetFollowTarget() const
+	{
+		ULocusReplicationConnectionGraph* Target = FollowTarget.Get();
+		return Target && !Target->bPendingRemoval ? Target : nullptr;
+	}
+
+	//followed connection that already gathered in ReplicationFrameNum. it's recorded lists replace follower's own spatial gathers
+	ULocusReplicationConnectionGraph* GetGatheredFollowTarget(uint32 ReplicationFrameNum) const
+	{
+		ULocusReplicationConnectionGraph* Target = GetFollowTarget();
+		return Target && Target->FollowListFrame == ReplicationFrameNum ? Target : nullptr;
+	}
+};
+
+//Time a gather into gathering connection's GatherCycles. only outermost scope counts so view follow and team fallbacks aren't counted twice
+struct FLocusScopedConnectionGatherCycles
+{
+public:
+	explicit FLocusScopedConnectionGatherCycles(const FConnectionGatherActorListParameters& Params)
+		: ConnManager(Cast<ULocusReplicationConnectionGraph>(&Params.ConnectionManager))
+		, StartCycles(0)
+	{
+		if (ConnManager && ConnManager->GatherDepth++ == 0)
+		{
+			StartCycles = FPlatformTime::Cycles64();
+		}
+	}
+
+	~FLocusScopedConnectionGatherCycles()
+	{
+		if (ConnManager && --ConnManager->GatherDepth == 0)
+		{
+			ConnManager->GatherCycles += FPlatformTime::Cycles64() - StartCycles;
+		}
+	}
+
+private:
+	ULocusReplicationConnectionGraph* ConnManager;
+	uint64 StartCycles;
+};
+
+//Spatial or team gather that followed connections record for their followers.
+//Followed connection copies lists the gather appended into it's follow lists, a follower whose target already gathered this frame skips spatial gathers.
+//Only outermost scope records, so team grid inside team gather is recorded once.
+struct FLocusScopedFollowGather
+{
+public:
+	FLocusScopedFollowGather(const FConnectionGatherActorListParameters& InParams, bool bSpatial);
+	~FLocusScopedFollowGather();
+
+	//gather must return, ViewFollow node appends followed connection's recorded lists instead
+	bool ShouldSkip() const { return bSkip; }
+
+private:
+	const FConnectionGatherActorListParameters& Params;
+	ULocusReplicationConnectionGraph* ConnManager;
+	FActorRepListRefView* RecordList;
+	int32 NumListsBefore;
+	bool bSkip;
+};
+
+//Appends lists the followed connection recorded this frame for view followers(spectators, casters), in place of their own spatial gathers.
+//Followers are ordered after their targets in Connections. target's PlayerController and owner only actors stay private to it.
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_ViewFollow : public UReplicationGraphNode
+{
+	GENERATED_BODY()
+
+public:
+	virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo) override {}
+	virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override { return false; }
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
 };
 /**
  * 
@@ -168,19 +516,131 @@ public:
 	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "1000.0", ClampMax = "100000.0", UIMin = "1000.0", UIMax = "100000.0"))
 	float SpacialCellSize = 10000.f;
 
-	// Spatial grid out of bound bias. Better not change this.
+	// Spatial grid out of bound bias. Only used when spatial bounds of a world can't be found.
 	UPROPERTY(EditDefaultsOnly)
 	FVector2D SpatialBias = FVector2D(-150000.f, -200000.f);
 
+	// Derive grid origin and extent from level bounds of each world. Actors outside of them go to an overflow list instead of rebuilding the grid.
+	UPROPERTY(EditDefaultsOnly)
+	bool bAutoSpatialBounds = true;
+
+	// Spatial bounds per map name, used instead of level bounds. Z is ignored.
+	UPROPERTY(EditDefaultsOnly)
+	TMap<FName, FBox> SpatialBoundsOverrides;
+
+	// Extra space around level bounds, covers streaming levels that are not loaded yet.
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0.0", UIMin = "0.0"))
+	float SpatialBoundsMargin = 20000.f;
+
+	// Seconds between checks of moving actors against spatial bounds.
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0.0", UIMin = "0.0"))
+	float OutOfBoundsCheckInterval = 1.f;
+
+	// Spatialize_Dynamic actors that stay still go to static grid path(dormancy path if dormant) and back to dynamic on their first move, so placed props that never move are not rebinned every frame
+	UPROPERTY(EditDefaultsOnly)
+	bool bAutoGridActorPaths = false;
+
+	// Seconds an actor must stay within GridPathMoveThreshold before it leaves dynamic path
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0.0", UIMin = "0.0"))
+	float GridPathStillTime = 5.f;
+
+	// Distance from where an actor settled that counts as a move and puts it back on dynamic path
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0.0", UIMin = "0.0"))
+	float GridPathMoveThreshold = 10.f;
+
 	// Should spatial grid rebuilt upon detecting an actor that is out of bias?
 	UPROPERTY(EditDefaultsOnly)
 	bool EnableSpatialRebuilds = false;
 
+	// Extra cell sizes of spatial grid layers. Each class goes to the smallest layer that covers it's cull distance. Empty uses a single SpacialCellSize grid.
+	UPROPERTY(EditDefaultsOnly)
+	TArray<float> SpatialLayerCellSizes;
+
+	// Largest cull distance a layer accepts, in cells. Higher values keep more classes in small layers but each actor spans more cells.
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0.5", UIMin = "0.5", UIMax = "8.0"))
+	float SpatialLayerCullDistanceInCells = 2.f;
+
+	// Cell size of team vision(fog of war) grid. Smaller cells follow vision radius more closely but cost more per moving source
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "100.0", UIMin = "100.0", UIMax = "20000.0"))
+	float TeamVisionCellSize = 2500.f;
+
+	// Horizontal voxel size of Spatialize_3D node.
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "1000.0", ClampMax = "100000.0", UIMin = "1000.0", UIMax = "100000.0"))
+	float VoxelCellSize = 10000.f;
+
+	// Vertical voxel size of Spatialize_3D node. Around a floor height works well.
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "100.0", UIMin = "100.0", UIMax = "10000.0"))
+	float VoxelVerticalCellSize = 1000.f;
+
+	// Directory of baked PVS tables under project content, one <MapName>.lpvs per map. Stage it as non-asset directory to copy.
+	UPROPERTY(EditDefaultsOnly)
+	FString PVSDirectory = TEXT("LocusPVS");
+
+	// How long(seconds) actors and team requests wait for their owner's connection before being dropped. 0 never expires
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0.0", UIMin = "0.0"))
+	float PendingActorExpireTime = 60.f;
+
 	UPROPERTY(EditDefaultsOnly)
 	TArray<FClassReplicationPolicyPreset> ReplicationPolicySettings;
 
 	UPROPERTY(EditDefaultsOnly)
 	TArray<FClassReplicationInfoPreset> ReplicationInfoSettings;
+
+	// Routing table baked by LocusBakeRoutingTable commandlet. Classes in it skip dynamic class pass at startup
+	UPROPERTY(EditDefaultsOnly)
+	TSoftObjectPtr<ULocusReplicationRoutingTable> RoutingTable;
+
+	// Route classes that are only relevant to owner(but not always relevant) to owner spatialized node, so they are culled by distance
+	UPROPERTY(EditDefaultsOnly)
+	bool bSpatializeOwnerOnlyActors = false;
+
+	// Stretch replication period of AdaptiveReplicationPeriod classes for connections that can't keep up with bandwidth
+	UPROPERTY(EditDefaultsOnly)
+	bool bAdaptiveReplicationPeriod = true;
+
+	// Smoothed saturation(ratio of frames connection was not net ready) above which period multiplier doubles
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0.0", ClampMax = "1.0", UIMin = "0.0", UIMax = "1.0"))
+	float AdaptivePeriodSaturationHigh = 0.5f;
+
+	// Smoothed saturation below which period multiplier halves. Keep it well below high threshold
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0.0", ClampMax = "1.0", UIMin = "0.0", UIMax = "1.0"))
+	float AdaptivePeriodSaturationLow = 0.1f;
+
+	// Largest period multiplier
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "1", ClampMax = "16", UIMin = "1", UIMax = "16"))
+	int32 AdaptivePeriodMaxMultiplier = 4;
+
+	// Seconds a multiplier stays before it can change again
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0.0", UIMin = "0.0"))
+	float AdaptivePeriodCooldown = 2.f;
+
+	// Rebalance bucket count of every frequency bucket node(dynamic actors of grid cells) from it's live actor count
+	UPROPERTY(EditDefaultsOnly)
+	bool bAdaptiveFrequencyBuckets = true;
+
+	// Target number of actors a bucket node replicates per frame
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "1", UIMin = "1", UIMax = "64"))
+	int32 FrequencyBucketActorsPerFrame = 12;
+
+	// Upper bound of buckets, an actor replicates at least once every this many frames
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "1", UIMin = "1", UIMax = "16"))
+	int32 FrequencyBucketMaxBuckets = 8;
+
+	// How many bucket nodes are checked per frame, spreads rebalancing over frames
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "1", UIMin = "1", UIMax = "64"))
+	int32 FrequencyBucketNodesPerFrame = 4;
+
+	// Watch owner chains of owner/team relevant actors every frame and reroute the ones whose owner changed. Without it, use ChangeOwnerOfAnActor
+	UPROPERTY(EditDefaultsOnly)
+	bool bTrackOwnerChanges = true;
+
+	// How many owner/team relevant actors bTrackOwnerChanges checks per frame, 0 checks all. An owner change is noticed within actors/this frames
+	UPROPERTY(EditDefaultsOnly, meta = (ClampMin = "0", UIMin = "0", UIMax = "4096", EditCondition = "bTrackOwnerChanges"))
+	int32 OwnerChangeChecksPerFrame = 512;
+
+	// Log resolved routing and replication settings of every class at startup
+	UPROPERTY(EditDefaultsOnly)
+	bool bLogClassSettings = false;
 	
 public:
 
@@ -206,9 +666,39 @@ public:
 
 	virtual void ResetGameWorldState() override;
 
-	//gridnode for spatialization handling
+	virtual void BeginDestroy() override;
+
+	//set up spatial bounds of the world before it's actors are routed
+	virtual void InitializeForWorld(UWorld* World) override;
+
+	//override for map, or level bounds of World plus margin. invalid if neither is available
+	FBox2D ComputeSpatialBounds(UWorld* World) const;
+
+	//baked PVS table file of a map
+	FString GetPVSFilename(const FString& MapName) const;
+
+	//gridnode for spatialization handling. AddActor_*/RemoveActor_* match UReplicationGraphNode_GridSpatialization2D, but it's not one
+	UPROPERTY()
+	UReplicationGraphNode_GridSpatialization2D_Layered* GridNode;
+
+	//layer of Spacial Cell Size, for code written against GridNode as UReplicationGraphNode_GridSpatialization2D.
+	//actors added to it directly bypass layer selection and bounds overflow, and have to be removed from it directly
+	UReplicationGraphNode_GridSpatialization2D* GetDefaultGridLayer() const { return GridNode ? GridNode->FindLayer(SpacialCellSize) : nullptr; }
+
+	//called by bucket nodes when they are created, rebalancing visits them in order of creation
+	void RegisterFrequencyBucketNode(UReplicationGraphNode_LocusFrequencyBuckets* BucketNode) { FrequencyBucketNodes.Add(BucketNode); }
+
+	UPROPERTY()
+	UReplicationGraphNode_VoxelSpatialization3D* VoxelNode;
+
+	UPROPERTY()
+	UReplicationGraphNode_TeamVision* TeamVisionNode;
+
+	UPROPERTY()
+	UReplicationGraphNode_PVS* PVSNode;
+
 	UPROPERTY()
-	UReplicationGraphNode_GridSpatialization2D* GridNode;
+	UReplicationGraphNode_ViewFollow* ViewFollowNode;
 
 	//always relevant for all connection
 	UPROPERTY()
@@ -218,15 +708,48 @@ public:
 	//TMap<FName, FActorRepListRefView> AlwaysRelevantStreamingLevelActors; //but this is not needed as AlwaysRelevantNode already handle streaming level
 
 	//Add Dependent Actor to ReplicationActor's Dep List, DependentActor will relevant according to Replicator's relevancy
+	//dependents of dependent follow too. changes are applied at next replication frame
 	void AddDependentActor(AActor* ReplicatorActor, AActor* DependentActor);
 	void RemoveDependentActor(AActor* ReplicatorActor, AActor* DependentActor);
+	void AddDependentActors(AActor* ReplicatorActor, const TArray<AActor*>& DependentActors);
+	void RemoveDependentActors(AActor* ReplicatorActor, const TArray<AActor*>& DependentActors);
+	void RemoveAllDependentActors(AActor* ReplicatorActor);
+
+	//direct or transitive dependents, queued changes are not included
+	void GetDependentActors(AActor* ReplicatorActor, TArray<AActor*>& OutDependentActors, bool bTransitive) const;
+
+	//apply queued dependency changes, once per frame
+	void ApplyDependencyChanges();
 	
-	//Change Owner of an actor that is relevant to connection specific
+	//Change Owner of an actor that is relevant to connection specific. actor and actors it owns are rerouted at next replication frame
 	void ChangeOwnerOfAnActor(AActor* ActorToChange, AActor* NewOwner);
 
+	//reroute actors whose owner chain changed since last frame, in one batch. pending entries whose owner got an owner are resolved too
+	void ProcessOwnerChanges();
+
+	//sample saturation of connections and update their replication period multipliers, once per frame
+	void UpdateAdaptiveReplicationPeriods();
+
+	//rebalance a few frequency bucket nodes, once per frame
+	void RebalanceFrequencyBuckets();
+
+	//cull owner spatialized nodes of all connections as parallel tasks, gather only copies results. once per frame
+	void PrecullConnectionNodes();
+
+	//flatten follow chains, count followers and keep followers after their targets in Connections, once per frame before gather
+	void UpdateFollowTargets();
+
 	//SetTeam via Name
 	void SetTeamForPlayerController(APlayerController* PlayerController, FName TeamName);
 
+	//Follower receives lists Target's spatial and team gathers appended every frame in place of it's own spatial gathers. null Target stops following
+	bool SetViewFollowTarget(APlayerController* Follower, APlayerController* Target);
+	void SetViewFollowTarget(ULocusReplicationConnectionGraph* Follower, ULocusReplicationConnectionGraph* Target);
+
+	//Source reveals RelevantTeamVision actors within Radius to connections of TeamName. adding again updates team and radius
+	void AddVisionSource(AActor* Source, FName TeamName, float Radius);
+	void RemoveVisionSource(AActor* Source);
+
 	//to handle actors that has no connection at addnofity execution
 	void RouteAddNetworkActorToConnectionNodes(EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo);
 	void RouteRemoveNetworkActorToConnectionNodes(EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo);
@@ -234,8 +757,19 @@ public:
 	//handle pending team requests and notifies
 	void HandlePendingActorsAndTeamRequests();
 
+	//renumber ConnectionOrderNum after connections were removed, once per frame
+	void CompactConnectionLists();
+
+	//route pending actors and team request that were waiting for this owner's connection
+	void ResolvePendingForOwner(AActor* Owner);
+
+	//update PlayerController lookup of connection and resolve pending entries for new PlayerController
+	void UpdateConnectionPlayerController(ULocusReplicationConnectionGraph* ConnManager, APlayerController* PlayerController);
+
 	ULocusReplicationConnectionGraph* FindLocusConnectionGraph(const AActor* Actor);
 
+	FLocusDependencyGraph DependencyGraph;
+
 	//Just copy-pasted from ShooterGame
 #if WITH_GAMEPLAY_DEBUGGER
 	void OnGameplayDebuggerOwnerChange(AGameplayDebuggerCategoryReplicator* Debugger, APlayerController* OldOwner);
@@ -243,18 +777,190 @@ public:
 
 	void PrintRepNodePolicies();
 
+	void PrintPolicyCacheStats();
+
+	void PrintAdaptiveReplicationPeriods();
+
+	//rolling averages and percentiles of routing, pending, team gather and per connection actor counts
+	void PrintStats();
+	void ResetStats();
+
+	//move counters of last frame into rolling stats, once per frame
+	void SampleStats();
+
+	FLocusReplicationGraphStats Stats;
+
+	//stream graph inputs to a trace file for LocusReplicationBenchmark -Trace replay. empty Filename uses Saved/LocusTraces/<Map>_<Time>.lrtrace
+	bool StartTrace(const FString& Filename = FString());
+	void StopTrace();
+	bool IsTracing() const { return TraceWriter.IsValid(); }
+
+	//viewer and moved actor locations of this frame, once per frame before gather
+	void RecordTraceFrame();
+
+	//run dynamic class pass and store result to routing table. used by LocusBakeRoutingTable commandlet
+	void BakeRoutingTable(ULocusReplicationRoutingTable* Table, float ServerMaxTickRate);
+
+	//replace presets at runtime. only classes whose presets changed and their children are resolved again,
+	//their live actors get new infos in place and are rerouted in one batch when policy changed or they are spatialized
+	void ApplyClassSettings(const TArray<FClassReplicationPolicyPreset>& NewPolicySettings, const TArray<FClassReplicationInfoPreset>& NewInfoSettings);
+	//apply presets of class defaults, picks up edited graph blueprint
+	void ReloadClassSettings();
+
+	//first preset of Class, or a new one filled with current settings of Class
+	FClassReplicationInfoPreset GetClassInfoPreset(UClass* Class);
+
+	//per actor replication info on top of it's class info, for bosses, objective carriers and the like
+	//applied in place to global and connection infos, actor stays in it's node. cleared when actor is removed from graph
+	bool SetActorCullDistanceOverride(AActor* Actor, float CullDistance);
+	bool SetActorReplicationPeriodOverride(AActor* Actor, int32 ReplicationPeriodFrame);
+	bool SetActorPriorityScaleOverride(AActor* Actor, float DistancePriorityScale, float StarvationPriorityScale);
+	//restore class values of Actor
+	void ClearActorReplicationOverrides(AActor* Actor);
+	bool HasActorReplicationOverrides(const AActor* Actor) const { return ActorOverrides.Find(Actor) != nullptr; }
+
+	void PrintActorOverrides();
+
 private:
 
 	EClassRepNodeMapping GetMappingPolicy(UClass* Class);
 
+	//node part of route add/remove, policy is given so actors can be removed with policy they were added with
+	void RouteAddActorWithPolicy(EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo);
+	void RouteRemoveActorWithPolicy(EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo);
+
+	//policy from engine class list or actor flags, false if class just inherits policy of it's super
+	bool ResolveDefaultPolicy(UClass* Class, EClassRepNodeMapping& OutPolicy) const;
+
+	//resolve policies and class infos of classes under changed presets again, from current preset arrays
+	void UpdateClassSettings(const TSet<const UClass*>& PolicyRoots, const TSet<const UClass*>& InfoRoots);
+
+	//dynamic class pass, resolves policies and class infos of every loaded replicated class except ResolvedClasses
+	void ResolveClassSettings(float ServerMaxTickRate, const TSet<const UClass*>& ResolvedClasses, TArray<UClass*>& OutReplicatedClasses);
+
+	//hash of presets and settings the dynamic class pass depends on, stored in baked routing table
+	uint32 GetClassSettingsHash() const;
+
+	//set policies and class infos of loaded classes in baked routing table
+	void ApplyRoutingTable(const ULocusReplicationRoutingTable* Table, float ServerMaxTickRate, TSet<const UClass*>& OutBakedClasses);
+
+	void LogClassSettings();
+
 	bool IsSpatialized(EClassRepNodeMapping Mapping) const { return Mapping >= EClassRepNodeMapping::Spatialize_Static; }
 
+	//policies routed to connection nodes of actor's owner
+	bool IsConnectionRelevant(EClassRepNodeMapping Mapping) const { return Mapping == EClassRepNodeMapping::RelevantOwnerConnection || Mapping == EClassRepNodeMapping::RelevantTeamConnection || Mapping == EClassRepNodeMapping::RelevantOwnerConnection_Spatialized || Mapping == EClassRepNodeMapping::RelevantTeamConnection_Spatialized; }
+
+	//connection specific policies that are still culled by distance
+	bool UsesCullDistance(EClassRepNodeMapping Mapping) const { return IsSpatialized(Mapping) || Mapping == EClassRepNodeMapping::RelevantOwnerConnection_Spatialized || Mapping == EClassRepNodeMapping::RelevantTeamConnection_Spatialized; }
+
 	TClassMap<EClassRepNodeMapping> ClassRepNodePolicies;
 
-	friend UReplicationGraphNode_AlwaysRelevant_ForTeam;
-	FTeamConnectionListMap TeamConnectionListMap;
+	//add/remove flattened dependent to engine's dependent list of replicator
+	void SetEngineDependentActor(AActor* ReplicatorActor, AActor* DependentActor, bool bAdd);
+
+	//VerticalCullDistance of presets, for Spatialize_3D actors
+	TClassMap<float> ClassVerticalCullDistances;
+
+	//AdaptiveReplicationPeriod of presets, and whether child classes inherit it
+	struct FAdaptivePeriodPreset
+	{
+		bool bAdaptive = false;
+		bool bIncludeChildClasses = true;
+	};
+	TMap<const UClass*, FAdaptivePeriodPreset> ClassAdaptivePeriods;
 
-	TArray<AActor*> PendingConnectionActors;
-	TArray<FTeamRequest> PendingTeamRequests;
+	//nearest preset up the super chain that covers Class decides, like class infos
+	bool IsAdaptivePeriodClass(const UClass* Class) const;
 
+	//networked actors of adaptive classes, so multiplier changes don't walk every actor info of a connection
+	TSet<FActorRepListType> AdaptivePeriodActors;
+
+	//set ReplicationPeriodFrame of adaptive classes in connection's actor infos from it's multiplier
+	void ApplyReplicationPeriodMultiplier(ULocusReplicationConnectionGraph* ConnManager);
+
+	//per node inputs of PrecullConnectionNodes, viewers are snapshotted on game thread
+	struct FPrecullTask
+	{
+		UReplicationGraphNode_OwnerSpatialized* Node;
+		int32 ViewerIndex;
+	};
+	TArray<FPrecullTask> PrecullTasks;
+	TArray<FNetViewerArray> PrecullViewers;
+	TArray<const TSet<FName>*> PrecullVisibleLevels;
+
+	//every bucket node of grid cells, swept round robin
+	TArray<TWeakObjectPtr<UReplicationGraphNode_LocusFrequencyBuckets>> FrequencyBucketNodes;
+	int32 NextFrequencyBucketNode = 0;
+
+	//baked result of ClassRepNodePolicies, queried first in GetMappingPolicy
+	FLocusClassPolicyTable ClassPolicyTable;
+
+	void OnPostGarbageCollect();
+	FDelegateHandle PostGarbageCollectHandle;
+
+	//Add Connection to team, if there's no team node, create one.
+	void AddConnectionToTeam(FName TeamName, ULocusReplicationConnectionGraph* ConnManager);
+
+	//Remove Connection from team, if there's no member of the team after removal, remove team node
+	void RemoveConnectionFromTeam(FName TeamName, ULocusReplicationConnectionGraph* ConnManager);
+
+	//team shared nodes keyed by team name
+	UPROPERTY()
+	TMap<FName, UReplicationGraphNode_AlwaysRelevant_TeamShared*> TeamSharedNodes;
+
+	//grids of removed teams. CreateNewNode registers grids for PrepareForReplication for graph's lifetime, so they are reused by new teams
+	UPROPERTY()
+	TArray<UReplicationGraphNode_GridSpatialization2D_Layered*> FreeTeamGridNodes;
+
+	//apply layer, bounds and path settings of global grid to Grid
+	void InitGridNode(UReplicationGraphNode_GridSpatialization2D_Layered* Grid) const;
+
+	//add actor to pending entry of its top net owner
+	void AddPendingActor(AActor* Actor);
+	//remove actor from pending entry, returns true if it was pending
+	bool RemovePendingActor(AActor* Actor);
+	//drop expired entries and retry entries whose owner is not a player controller
+	void SweepPendingOwners();
+
+	//pending actors and team requests keyed by top net owner
+	TMap<TWeakObjectPtr<AActor>, FPendingOwnerEntry> PendingOwners;
+	//pending actor -> owner key of PendingOwners, for O(1) removal
+	TMap<TWeakObjectPtr<AActor>, TWeakObjectPtr<AActor>> PendingActorOwners;
+	//next platform time SweepPendingOwners runs
+	double NextPendingSweepTime = 0.0;
+
+	//initialized connections, also used as NetConnection -> ConnectionGraph lookup
+	FLocusConnectionSlots ConnectionSlots;
+	//PlayerController -> ConnectionGraph lookup
+	TMap<TWeakObjectPtr<APlayerController>, ULocusReplicationConnectionGraph*> ConnectionsByPlayerController;
+	//some connection is removed, lists should be compacted
+	bool bConnectionListsDirty = false;
+
+	//add/remove actor to connection nodes of policy
+	void AddActorToConnectionNodes(ULocusReplicationConnectionGraph* ConnManager, EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo);
+	void RemoveActorFromConnectionNodes(ULocusReplicationConnectionGraph* ConnManager, EClassRepNodeMapping Policy, const FNewReplicatedActorInfo& ActorInfo);
+
+	//owner/team relevant actors routed to a connection, or without connection while they have no owner
+	TMap<FActorRepListType, FRoutedOwnerActor> RoutedOwnerActors;
+	//keys of RoutedOwnerActors, walked round robin by owner change tracking
+	TArray<FActorRepListType> OwnerCheckOrder;
+	int32 NextOwnerCheck = 0;
+
+	FRoutedOwnerActor& AddRoutedOwnerActor(AActor* Actor);
+	bool RemoveRoutedOwnerActor(AActor* Actor, FRoutedOwnerActor& OutRouted);
+	//actors passed to ChangeOwnerOfAnActor, rerouted with what they own at next ProcessOwnerChanges
+	TSet<TWeakObjectPtr<AActor>> QueuedOwnerChanges;
+
+	//set Fields of Actor's override with Setter and apply it. false if Actor is not replicated by this graph
+	bool SetActorOverride(AActor* Actor, uint8 Fields, TFunctionRef<void(FLocusActorReplicationOverride&)> Setter);
+	//reset infos of Actor to class info plus it's override. spatialized actors are rebinned in their node when cull distance changed
+	void RefreshActorReplicationInfo(AActor* Actor);
+
+	FLocusActorOverrideTable ActorOverrides;
+
+	//write connections, teams, routed actors and dependencies that existed before trace started
+	void WriteTraceSnapshot();
+
+	TUniquePtr<FLocusTraceWriter> TraceWriter;
 };
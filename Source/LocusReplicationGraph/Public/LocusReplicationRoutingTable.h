@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "LocusReplicationGraph.h"
+#include "LocusReplicationRoutingTable.generated.h"
+
+// Resolved routing policy and replication info of a class
+USTRUCT()
+struct LOCUSREPLICATIONGRAPH_API FLocusBakedClassRouting
+{
+	GENERATED_BODY()
+public:
+	// Soft reference, so loading the table does not load every class in it
+	UPROPERTY(VisibleAnywhere)
+	TSoftClassPtr<AActor> Class;
+
+	UPROPERTY(VisibleAnywhere)
+	EClassRepNodeMapping Policy = EClassRepNodeMapping::NotRouted;
+
+	UPROPERTY(VisibleAnywhere)
+	float DistancePriorityScale = 1.f;
+
+	UPROPERTY(VisibleAnywhere)
+	float StarvationPriorityScale = 1.f;
+
+	UPROPERTY(VisibleAnywhere)
+	float CullDistanceSquared = 0.f;
+
+	UPROPERTY(VisibleAnywhere)
+	uint8 ReplicationPeriodFrame = 1;
+
+	UPROPERTY(VisibleAnywhere)
+	uint8 ActorChannelFrameTimeout = 4;
+
+	FClassReplicationInfo CreateClassReplicationInfo() const
+	{
+		FClassReplicationInfo Info;
+		Info.DistancePriorityScale = DistancePriorityScale;
+		Info.StarvationPriorityScale = StarvationPriorityScale;
+		Info.SetCullDistanceSquared(CullDistanceSquared);
+		Info.ReplicationPeriodFrame = ReplicationPeriodFrame;
+		Info.ActorChannelFrameTimeout = ActorChannelFrameTimeout;
+		return Info;
+	}
+
+	void SetClassReplicationInfo(const FClassReplicationInfo& Info)
+	{
+		DistancePriorityScale = Info.DistancePriorityScale;
+		StarvationPriorityScale = Info.StarvationPriorityScale;
+		CullDistanceSquared = Info.GetCullDistanceSquared();
+		ReplicationPeriodFrame = Info.ReplicationPeriodFrame;
+		ActorChannelFrameTimeout = Info.ActorChannelFrameTimeout;
+	}
+};
+
+/**
+ * Routing/settings table generated by LocusBakeRoutingTable commandlet.
+ * Server applies it at startup instead of resolving every class dynamically.
+ */
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API ULocusReplicationRoutingTable : public UDataAsset
+{
+	GENERATED_BODY()
+public:
+	// NetServerMaxTickRate used to compute replication periods. Table is ignored if server runs different tick rate
+	UPROPERTY(VisibleAnywhere)
+	float BakedServerMaxTickRate = 30.f;
+
+	// Hash of graph's presets and routing settings at bake. Table is ignored if they were edited since
+	UPROPERTY(VisibleAnywhere)
+	uint32 BakedSettingsHash = 0;
+
+	UPROPERTY(VisibleAnywhere)
+	TArray<FLocusBakedClassRouting> Classes;
+};
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+#include "CoreMinimal.h"
+
+//Node types whose gathers are timed
+enum class ELocusGatherStat : uint8
+{
+	Grid,
+	Voxel,
+	PVS,
+	TeamVision,
+	Owner,
+	Team,
+	ViewFollow,
+	Num
+};
+
+LOCUSREPLICATIONGRAPH_API const TCHAR* LexToString(ELocusGatherStat Stat);
+
+//Fixed size ring of per frame samples, for rolling averages and percentiles
+struct LOCUSREPLICATIONGRAPH_API FLocusStatBuffer
+{
+public:
+	explicit FLocusStatBuffer(int32 InCapacity = 256) : Capacity(FMath::Max(InCapacity, 1)) {}
+
+	void Add(float Value);
+	void Reset();
+
+	int32 Num() const { return Samples.Num(); }
+	float GetAverage() const;
+	float GetMax() const;
+	//nearest rank percentile, Percentile in 0..1
+	float GetPercentile(float Percentile) const;
+
+private:
+	TArray<float> Samples;
+	int32 Capacity;
+	int32 NextIndex = 0;
+};
+
+//Adds cycles spent in a scope to an accumulator
+struct FLocusScopedStatCycles
+{
+public:
+	explicit FLocusScopedStatCycles(uint64& InAccumulator) : Accumulator(InAccumulator), StartCycles(FPlatformTime::Cycles64()) {}
+	~FLocusScopedStatCycles() { Accumulator += FPlatformTime::Cycles64() - StartCycles; }
+
+private:
+	uint64& Accumulator;
+	uint64 StartCycles;
+};
+
+/**
+ * Rolling stats of a LocusReplicationGraph. Cycles and counts are accumulated during a frame,
+ * then moved into buffers once per frame and printed by LocusRepGraph.Stats.
+ */
+struct LOCUSREPLICATIONGRAPH_API FLocusReplicationGraphStats
+{
+public:
+	//accumulated during current frame
+	uint64 RouteAddCycles = 0;
+	uint64 RouteRemoveCycles = 0;
+	uint64 PendingCycles = 0;
+	//nested gathers(view follow, team falling back to owner cull) count to both
+	uint64 GatherCycles[(int32)ELocusGatherStat::Num] = {};
+	int32 NumRouteAdds = 0;
+	int32 NumRouteRemoves = 0;
+
+	FLocusStatBuffer RouteAddMs;
+	FLocusStatBuffer RouteRemoveMs;
+	FLocusStatBuffer PendingMs;
+	FLocusStatBuffer GatherMs[(int32)ELocusGatherStat::Num];
+	FLocusStatBuffer RouteAdds;
+	FLocusStatBuffer RouteRemoves;
+	FLocusStatBuffer PendingActors;
+	FLocusStatBuffer PendingOwners;
+	FLocusStatBuffer Teams;
+	FLocusStatBuffer MaxTeamSize;
+	FLocusStatBuffer ConnectionActors;
+	FLocusStatBuffer MaxConnectionGatherMs;
+	FLocusStatBuffer GridStaticActors;
+	FLocusStatBuffer GridDynamicActors;
+	FLocusStatBuffer GridDormancyActors;
+	FLocusStatBuffer GridPathChanges;
+
+	//move accumulated cycles and counts of last frame into buffers
+	void EndFrame();
+	void Reset();
+
+	static void PrintBuffer(const TCHAR* Name, const FLocusStatBuffer& Buffer);
+};
@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Dom/JsonObject.h"
+#include "UObject/ObjectKey.h"
+
+class AActor;
+class APlayerController;
+class FLocusReplicationBenchmark;
+
+//Record types of a trace file. Each record is a type byte followed by it's fields, native endian
+enum class ELocusTraceRecord : uint8
+{
+	//uint32 Id, string. class paths and team names are written once and referenced by id
+	String,
+	//uint32 FrameNum, float DeltaSeconds. a replication frame ran on everything recorded before it
+	Frame,
+	//uint32 ActorId, uint32 ClassId, uint32 OwnerId, vector Location
+	AddActor,
+	//uint32 ActorId
+	RemoveActor,
+	//uint32 ActorId, vector Location. written when actor moved more than LocusRepGraph.TraceMoveThreshold
+	MoveActor,
+	//uint32 ConnectionId
+	AddConnection,
+	//uint32 ConnectionId
+	RemoveConnection,
+	//uint32 ConnectionId, uint32 ActorId
+	ConnectionPlayerController,
+	//uint32 ConnectionId, vector ViewLocation
+	ViewerLocation,
+	//uint32 ActorId, uint32 TeamId(0 for NAME_None)
+	SetTeam,
+	//uint32 ActorId, uint32 OwnerId
+	ChangeOwner,
+	//uint32 ReplicatorId, uint32 DependentId
+	AddDependent,
+	//uint32 ReplicatorId, uint32 DependentId(0 removes all)
+	RemoveDependent,
+	Num
+};
+
+/**
+ * Streams inputs of a LocusReplicationGraph to a binary trace file.
+ * Records are appended to a memory buffer and written by a background task, so the game thread never waits on disk unless the previous write is still running.
+ * Actors and connections get small sequential ids, 0 is null.
+ * They are keyed by FObjectKey, so an object allocated at the address of a destroyed one gets a new id.
+ */
+class LOCUSREPLICATIONGRAPH_API FLocusTraceWriter
+{
+public:
+	//file layout: header, graph class path, spatial bounds(4 floats), records
+	struct FHeader
+	{
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		//patched when the writer is closed, 0 if the server went down while tracing
+		int32 NumFrames = 0;
+	};
+
+	static const uint32 FileMagic = 0x5254524C; //LRTR
+	static const uint32 FileVersion = 1;
+
+	//null if the file can't be created
+	static TUniquePtr<FLocusTraceWriter> Create(const FString& Filename, const FString& GraphClassPath, const FBox2D& SpatialBounds);
+	~FLocusTraceWriter();
+
+	void AddActor(AActor* Actor, AActor* Owner);
+	void RemoveActor(AActor* Actor);
+	void AddConnection(const UObject* Connection);
+	void RemoveConnection(const UObject* Connection);
+	void SetConnectionPlayerController(const UObject* Connection, APlayerController* PlayerController);
+	void SetTeam(APlayerController* PlayerController, FName TeamName);
+	void ChangeOwner(AActor* Actor, AActor* NewOwner);
+	void SetDependentActor(AActor* ReplicatorActor, AActor* DependentActor, bool bAdd);
+
+	//per frame, viewer and actor locations first then MarkFrame
+	void ViewerLocation(const UObject* Connection, const FVector& ViewLocation);
+	//write MoveActor for routed actors which moved farther than Threshold since their last record
+	void UpdateActorLocations(float Threshold);
+	void MarkFrame(uint32 FrameNum, float DeltaSeconds);
+
+	const FString& GetFilename() const { return Filename; }
+	int64 GetTotalBytes() const { return TotalBytes + Buffer.Num(); }
+	int32 GetNumFrames() const { return NumFrames; }
+
+private:
+	FLocusTraceWriter(const FString& InFilename, FArchive* InArchive);
+
+	struct FTracedActor
+	{
+		//actors destroyed without being removed(world reset) go stale, their entries are dropped
+		TWeakObjectPtr<AActor> Actor;
+		uint32 Id = 0;
+		bool bRouted = false;
+		bool bTrackMovement = false;
+		FVector Location = FVector::ZeroVector;
+	};
+
+	uint32 GetActorId(AActor* Actor);
+	uint32 GetConnectionId(const UObject* Connection);
+	uint32 GetStringId(const FString& String);
+
+	void WriteRecord(ELocusTraceRecord Record) { Write((uint8)Record); }
+	template<typename T>
+	void Write(const T& Value) { Buffer.Append((const uint8*)&Value, sizeof(T)); }
+	void WriteVector(const FVector& Vector);
+	void WriteString(const FString& String);
+
+	//hand buffer to background write once it's large enough
+	void Flush(bool bWait);
+
+	FString Filename;
+	TUniquePtr<FArchive> Archive;
+	TArray<uint8> Buffer;
+	TArray<uint8> WriteBuffer;
+	TFuture<void> PendingWrite;
+	int64 TotalBytes = 0;
+	int32 NumFrames = 0;
+
+	TMap<FObjectKey, FTracedActor> Actors;
+	TMap<FObjectKey, uint32> Connections;
+	TMap<FString, uint32> Strings;
+	uint32 NextActorId = 1;
+	uint32 NextConnectionId = 1;
+	uint32 NextStringId = 1;
+};
+
+/**
+ * Feeds a trace back into the headless graph of a FLocusReplicationBenchmark, replicating a frame at every Frame record without waiting.
+ * Actors are spawned with their traced classes. Connection PlayerControllers are created together with their connection, so traced PlayerController actors are not spawned.
+ */
+class LOCUSREPLICATIONGRAPH_API FLocusTraceReplay
+{
+public:
+	bool Load(const FString& InFilename);
+
+	const FString& GetGraphClassPath() const { return GraphClassPath; }
+	const FBox2D& GetSpatialBounds() const { return SpatialBounds; }
+	int32 GetNumFrames() const { return NumFrames; }
+
+	//replay every record into initialized Benchmark. false if the trace is corrupt
+	bool Run(FLocusReplicationBenchmark& Benchmark);
+
+	TSharedRef<FJsonObject> GetResults() const;
+
+private:
+	template<typename T>
+	bool Read(T& Value)
+	{
+		if (Offset + (int64)sizeof(T) > Data.Num())
+		{
+			return false;
+		}
+		FMemory::Memcpy(&Value, Data.GetData() + Offset, sizeof(T));
+		Offset += sizeof(T);
+		return true;
+	}
+	bool ReadVector(FVector& Vector);
+	bool ReadString(FString& String);
+
+	AActor* FindActor(uint32 ActorId) const { return ActorId > 0 && ActorId < (uint32)ReplayActors.Num() ? ReplayActors[ActorId] : nullptr; }
+	UClass* FindClass(uint32 ClassId);
+
+	FString Filename;
+	TArray<uint8> Data;
+	int64 Offset = 0;
+	int64 RecordsOffset = 0;
+
+	FString GraphClassPath;
+	FBox2D SpatialBounds = FBox2D(ForceInit);
+	int32 NumFrames = 0;
+
+	TMap<uint32, FString> Strings;
+	TMap<uint32, UClass*> Classes;
+	TArray<AActor*> ReplayActors;
+	TArray<APlayerController*> ReplayConnections;
+
+	int32 NumRecords = 0;
+	int32 NumSpawned = 0;
+	int32 NumSkipped = 0;
+	TSet<FString> MissingClasses;
+	double ReplaySeconds = 0.0;
+};
@@ -0,0 +1,349 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "LocusSpatialNodes.generated.h"
+
+DECLARE_STATS_GROUP(TEXT("LocusReplicationGraph"), STATGROUP_LocusReplicationGraph, STATCAT_Advanced);
+
+//Frequency buckets of grid cells. Registers itself to ULocusReplicationGraph's bucket rebalancing when created
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_LocusFrequencyBuckets : public UReplicationGraphNode_ActorListFrequencyBuckets
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(const TSharedPtr<FReplicationGraphGlobalData>& InGraphGlobals) override;
+
+	//counted on add/remove, streaming level actors are not bucketed
+	int32 NumNonStreamingActors() const { return TotalNumNonStreamingActors; }
+};
+
+/**
+ * Grid layer that can preallocate it's cell arrays for a known area, so actors inside it never grow or rebuild the grid.
+ * Dynamic nodes of it's cells are UReplicationGraphNode_LocusFrequencyBuckets.
+ */
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_GridLayer : public UReplicationGraphNode_GridSpatialization2D
+{
+	GENERATED_BODY()
+
+public:
+	UReplicationGraphNode_GridLayer();
+
+	//size cell arrays to cover Bounds, SpatialBias should already be Bounds.Min
+	void PreallocateGrid(const FBox2D& Bounds);
+};
+
+/**
+ * Spatial grid made of several grid layers with different cell sizes.
+ * Each actor goes to the smallest layer whose cell size covers it's cull distance,
+ * so long range actors don't span hundreds of small cells and short range queries don't return huge cells.
+ * When spatial bounds are set, actors outside of them go to an overflow list instead of forcing a grid rebuild.
+ */
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_GridSpatialization2D_Layered : public UReplicationGraphNode
+{
+	GENERATED_BODY()
+
+public:
+	UReplicationGraphNode_GridSpatialization2D_Layered();
+
+	//which add function an actor came through
+	enum class EGridPath : uint8
+	{
+		Static,
+		Dynamic,
+		Dormancy,
+	};
+	static constexpr int32 NumGridPaths = 3;
+
+	//create one grid layer per cell size. cell sizes are sorted ascending
+	void InitLayers(TArray<float> CellSizes, const FVector2D& SpatialBias, bool bEnableSpatialRebuilds, float MaxCellsPerCullDistance);
+
+	//move grid origin to Bounds.Min and preallocate cells. invalid bounds restores default bias and disables overflow handling
+	void SetSpatialBounds(const FBox2D& Bounds);
+
+	const FBox2D& GetSpatialBounds() const { return SpatialBounds; }
+	FVector2D GetSpatialBias() const { return SpatialBounds.bIsValid ? SpatialBounds.Min : DefaultSpatialBias; }
+
+	void AddActor_Static(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo);
+	void AddActor_Dynamic(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo);
+	void AddActor_Dormancy(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo);
+	//dynamic actor whose path follows it's movement. still for AutoPathStillTime goes to static path(dormancy path if dormant), first move goes back to dynamic
+	void AddActor_Auto(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo);
+
+	//layer and path are remembered on add, so these are all the same
+	void RemoveActor_Static(const FNewReplicatedActorInfo& ActorInfo) { RemoveActor(ActorInfo); }
+	void RemoveActor_Dynamic(const FNewReplicatedActorInfo& ActorInfo) { RemoveActor(ActorInfo); }
+	void RemoveActor_Dormancy(const FNewReplicatedActorInfo& ActorInfo) { RemoveActor(ActorInfo); }
+	void RemoveActor(const FNewReplicatedActorInfo& ActorInfo);
+
+	virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& Actor) override;
+	virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override;
+	virtual void NotifyResetAllNetworkActors() override;
+	virtual void PrepareForReplication() override;
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+	virtual void GetAllActorsInNode_Debugging(TArray<FActorRepListType>& OutArray) const override;
+
+	//layer index an actor with this replication info goes to
+	int32 GetLayerIndex(const FGlobalActorReplicationInfo& ActorRepInfo) const;
+
+	//layer with exactly CellSize, null if there's none
+	UReplicationGraphNode_GridLayer* FindLayer(float CellSize) const
+	{
+		UReplicationGraphNode_GridLayer* const* Layer = Layers.FindByPredicate([CellSize](const UReplicationGraphNode_GridLayer* GridLayer) { return GridLayer->CellSize == CellSize; });
+		return Layer ? *Layer : nullptr;
+	}
+
+	int32 NumOutOfBoundsActors() const { return OutOfBoundsActors.Num(); }
+	int32 NumActors(EGridPath Path) const { return NumActorsByPath[(int32)Path]; }
+
+	UPROPERTY()
+	TArray<UReplicationGraphNode_GridLayer*> Layers;
+
+	//actors outside of spatial bounds. gathered by every connection, distance culling is left to the graph
+	UPROPERTY()
+	UReplicationGraphNode_ActorList* OverflowNode;
+
+	//seconds between checks of moving actors against spatial bounds
+	float OutOfBoundsCheckInterval = 1.f;
+
+	//seconds an auto path actor stays within AutoPathMoveThreshold before it leaves dynamic path
+	float AutoPathStillTime = 5.f;
+	//distance from where an auto path actor settled that counts as a move
+	float AutoPathMoveThreshold = 10.f;
+	//auto path actors moved between paths in last PrepareForReplication
+	int32 NumAutoPathChanges = 0;
+
+protected:
+	struct FGridActor
+	{
+		FNewReplicatedActorInfo ActorInfo;
+		FGlobalActorReplicationInfo* GlobalInfo = nullptr;
+		int32 LayerIndex = 0;
+		EGridPath Path = EGridPath::Static;
+		bool bOutOfBounds = false;
+	};
+
+	void AddActor(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo, EGridPath Path);
+	void AddToGrid(const FGridActor& GridActor);
+	void RemoveFromGrid(const FGridActor& GridActor);
+	bool IsInBounds(const FVector& Location) const { return !SpatialBounds.bIsValid || SpatialBounds.IsInside(FVector2D(Location)); }
+
+	//move actors that crossed spatial bounds between grid and overflow
+	void CheckOutOfBoundsActors();
+
+	struct FAutoPathActor
+	{
+		FVector SettledLocation = FVector::ZeroVector;
+		double LastMoveTime = 0.0;
+	};
+
+	//move auto path actors between dynamic and static/dormancy path from their movement
+	void UpdateAutoPaths();
+	void SetPath(FGridActor& GridActor, EGridPath Path);
+
+	//largest cull distance each layer accepts
+	TArray<float> LayerMaxCullDistances;
+
+	//every actor in this node, remembers layer and path so removal goes to the same place even if settings changed
+	TMap<FActorRepListType, FGridActor> GridActors;
+
+	TSet<FActorRepListType> OutOfBoundsActors;
+	TMap<FActorRepListType, FAutoPathActor> AutoPathActors;
+	int32 NumActorsByPath[NumGridPaths] = {};
+
+	FVector2D DefaultSpatialBias = FVector2D::ZeroVector;
+	FBox2D SpatialBounds = FBox2D(ForceInit);
+	double NextOutOfBoundsCheckTime = 0.0;
+};
+
+/**
+ * Sparse 3D spatialization for vertically layered maps. Only voxels that hold an actor exist.
+ * Like the 2D grid, an actor is put in every voxel within it's cull distance and viewers gather the voxel they are in,
+ * but vertical reach uses a separate per-class vertical cull distance, so floors above and below don't leak in.
+ */
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_VoxelSpatialization3D : public UReplicationGraphNode
+{
+	GENERATED_BODY()
+
+public:
+	UReplicationGraphNode_VoxelSpatialization3D();
+
+	//VerticalCullDistance 0 reaches one voxel above and below
+	void AddActor(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& ActorRepInfo, float VerticalCullDistance);
+	void RemoveActor(const FNewReplicatedActorInfo& ActorInfo);
+
+	virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& Actor) override;
+	virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override;
+	virtual void NotifyResetAllNetworkActors() override;
+	virtual void PrepareForReplication() override;
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+	virtual void GetAllActorsInNode_Debugging(TArray<FActorRepListType>& OutArray) const override;
+
+	FIntVector GetCellCoord(const FVector& Location) const;
+
+	//horizontal size of a voxel
+	float CellSize = 10000.f;
+
+	//vertical size of a voxel, usually about a floor height
+	float VerticalCellSize = 1000.f;
+
+	//max voxels an actor reaches above and below, bounds voxel count of actors with huge vertical cull distance
+	int32 MaxVerticalExtent = 4;
+
+	int32 NumCells() const { return Cells.Num(); }
+
+protected:
+	struct FVoxelActor
+	{
+		FNewReplicatedActorInfo ActorInfo;
+		FGlobalActorReplicationInfo* GlobalInfo = nullptr;
+		//voxel of actor location
+		FIntVector Cell;
+		//voxels covered around Cell on each axis
+		FIntVector Extent;
+	};
+
+	struct FVoxelCell
+	{
+		UReplicationGraphNode_ActorList* Node = nullptr;
+		int32 NumActors = 0;
+	};
+
+	void AddToCells(const FVoxelActor& VoxelActor);
+	void RemoveFromCells(const FVoxelActor& VoxelActor);
+	//move actor to NewCell, only voxels entering or leaving it's extent are touched
+	void MoveCells(FVoxelActor& VoxelActor, const FIntVector& NewCell);
+	void AddToCell(const FIntVector& Coord, const FNewReplicatedActorInfo& ActorInfo);
+	void RemoveFromCell(const FIntVector& Coord, const FNewReplicatedActorInfo& ActorInfo);
+	UReplicationGraphNode_ActorList* GetCell(const FIntVector& Coord) const;
+
+	TMap<FActorRepListType, FVoxelActor> VoxelActors;
+
+	//sparse voxel hash of non empty cells, cell nodes are owned through AllChildNodes
+	TMap<FIntVector, FVoxelCell> Cells;
+	//nodes of cells that became empty, reused before creating new ones
+	TArray<UReplicationGraphNode_ActorList*> FreeCells;
+};
+
+//Dense 2D cell layout over fixed bounds. Locations outside of bounds are clamped to edge cells
+struct LOCUSREPLICATIONGRAPH_API FLocusCellGrid
+{
+public:
+	void Init(const FBox2D& Bounds, float InCellSize);
+
+	bool IsValid() const { return NumX > 0 && NumY > 0; }
+	int32 Num() const { return NumX * NumY; }
+
+	FIntPoint GetCoord(const FVector& Location) const
+	{
+		return FIntPoint(
+			FMath::Clamp(FMath::FloorToInt((Location.X - Origin.X) / CellSize), 0, NumX - 1),
+			FMath::Clamp(FMath::FloorToInt((Location.Y - Origin.Y) / CellSize), 0, NumY - 1));
+	}
+	FIntPoint GetCoord(int32 Index) const { return FIntPoint(Index % NumX, Index / NumX); }
+
+	int32 GetIndex(const FIntPoint& Coord) const { return Coord.Y * NumX + Coord.X; }
+	int32 GetIndex(const FVector& Location) const { return GetIndex(GetCoord(Location)); }
+
+	FVector2D GetCellCenter(const FIntPoint& Coord) const { return Origin + FVector2D((Coord.X + 0.5f) * CellSize, (Coord.Y + 0.5f) * CellSize); }
+
+	//calls Func with index of every cell whose center is within Radius of center of cell CenterIndex
+	template<typename FuncType>
+	void ForEachCellInRadius(int32 CenterIndex, float Radius, FuncType Func) const
+	{
+		const FIntPoint Center = GetCoord(CenterIndex);
+		const int32 RadiusCells = FMath::CeilToInt(Radius / CellSize);
+		const float RadiusSquared = Radius * Radius;
+		for (int32 Y = FMath::Max(Center.Y - RadiusCells, 0); Y <= FMath::Min(Center.Y + RadiusCells, NumY - 1); ++Y)
+		{
+			for (int32 X = FMath::Max(Center.X - RadiusCells, 0); X <= FMath::Min(Center.X + RadiusCells, NumX - 1); ++X)
+			{
+				const float DistanceSquared = FMath::Square((X - Center.X) * CellSize) + FMath::Square((Y - Center.Y) * CellSize);
+				if (DistanceSquared <= RadiusSquared)
+				{
+					Func(GetIndex(FIntPoint(X, Y)));
+				}
+			}
+		}
+	}
+
+	FVector2D Origin = FVector2D::ZeroVector;
+	float CellSize = 0.f;
+	int32 NumX = 0;
+	int32 NumY = 0;
+};
+
+/**
+ * Fog of war relevance. Actors are binned into cells and are relevant to a team only while a vision source of that team covers their cell.
+ * Each team keeps a refcount per cell(refcount > 0 means visible) and a list of visible cells, both updated incrementally as sources cross cells.
+ */
+UCLASS()
+class LOCUSREPLICATIONGRAPH_API UReplicationGraphNode_TeamVision : public UReplicationGraphNode
+{
+	GENERATED_BODY()
+
+public:
+	UReplicationGraphNode_TeamVision();
+
+	//lay out cells over Bounds. existing actors and vision sources are binned again
+	void InitGrid(const FBox2D& Bounds, float CellSize);
+
+	//Source reveals cells within Radius to TeamName. adding again updates team and radius
+	void AddVisionSource(AActor* Source, FName TeamName, float Radius);
+	void RemoveVisionSource(AActor* Source);
+
+	bool IsVisibleToTeam(FName TeamName, const FVector& Location) const;
+
+	virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override;
+	virtual void NotifyResetAllNetworkActors() override;
+	virtual void PrepareForReplication() override;
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+	virtual void GetAllActorsInNode_Debugging(TArray<FActorRepListType>& OutArray) const override;
+
+protected:
+	struct FVisionSource
+	{
+		FName TeamName;
+		float Radius = 0.f;
+		int32 CellIndex = INDEX_NONE;
+	};
+
+	struct FTeamVision
+	{
+		//number of sources covering each cell
+		TArray<uint16> RefCounts;
+		//cells with refcount > 0, gathered by team connections
+		TArray<int32> VisibleCells;
+		//position of each cell in VisibleCells, INDEX_NONE if not visible
+		TArray<int32> VisibleCellSlots;
+	};
+
+	struct FVisionActor
+	{
+		FNewReplicatedActorInfo ActorInfo;
+		FGlobalActorReplicationInfo* GlobalInfo = nullptr;
+		int32 CellIndex = INDEX_NONE;
+	};
+
+	//add(+1) or remove(-1) cells a source covers to it's team
+	void UpdateFootprint(const FVisionSource& Source, int32 Delta);
+	FTeamVision& FindOrAddTeamVision(FName TeamName);
+	UReplicationGraphNode_ActorList* GetOrCreateCell(int32 CellIndex);
+
+	FLocusCellGrid Grid;
+
+	//dense cell lists, created when first actor enters
+	TArray<UReplicationGraphNode_ActorList*> Cells;
+	//cell nodes freed by InitGrid, reused before creating new ones
+	TArray<UReplicationGraphNode_ActorList*> FreeCells;
+
+	TMap<TWeakObjectPtr<AActor>, FVisionSource> VisionSources;
+	TMap<FName, FTeamVision> TeamVisions;
+	TMap<FActorRepListType, FVisionActor> VisionActors;
+};